@@ -5,7 +5,8 @@
 #include <opencv2/dnn.hpp>
 #include <opencv2/core/cuda.hpp>
 #include <iostream>
-#define Combined_Condition classIdPoint.x == 1 || classIdPoint.x == 0
+#include "forward_worker.h"
+#include "yolo_decoder.h"
 
 using namespace cv;
 using namespace cv::dnn;
@@ -24,21 +25,14 @@ void Blur(int toBlur, int left, int top, int right, int bottom, Mat& frame) {
     rectangle(frame, Point(left, top), Point(right, bottom), Scalar(0, 255, 0), 3);
 
     if(toBlur){
-        // Define the region of interest
-        cv::Rect roi(left, top, right - left + 1, bottom - top + 1);
+        // Define the region of interest, clipped so faces on the border
+        // are still blurred
+        cv::Rect roi = cv::Rect(left, top, right - left + 1, bottom - top + 1) & cv::Rect(0, 0, frame.cols, frame.rows);
 
-        // Check if the ROI is within the frame bounds
-        if (roi.x >= 0 && roi.y >= 0 && roi.width + roi.x <= frame.cols && roi.height + roi.y <= frame.rows) {
-            // Extract the ROI from the frame
+        if (!roi.empty()) {
+            // Blurred in place; the ROI shares the frame's pixels
             cv::Mat roiImg = frame(roi);
-
-            // Apply Gaussian blur to the extracted ROI
             cv::GaussianBlur(roiImg, roiImg, cv::Size(31, 31), 10.0, 10.0);
-        
-            // Copy the blurred ROI back to the original image
-            roiImg.copyTo(frame(roi));
-        } else {
-            std::cerr << "Error: ROI is out of bounds." << std::endl;
         }
     }
     
@@ -48,36 +42,17 @@ void Blur(int toBlur, int left, int top, int right, int bottom, Mat& frame) {
 }
 
 void postprocess(Mat& frame, const vector<Mat>& outs,bool toBlur = false) {
-    // vector<int> classIds;
     float CONFIDENCE_THRESHOLD = PERSON_CONFIDENCE_THRESHOLD;
     if(toBlur){
         CONFIDENCE_THRESHOLD = FACE_CONFIDENCE_THRESHOLD;
     }
     
+    vector<int> classIds;
     vector<float> confidences;
-    double confidence;
     vector<Rect> boxes;
 
-    for (size_t i = 0; i < outs.size(); ++i) {
-        float* data = (float*)outs[i].data;
-        for (int j = 0; j < outs[i].rows; ++j, data += outs[i].cols) {
-            cv::Mat scores = outs[i].row(j).colRange(5, outs[i].cols);
-            cv::Point classIdPoint;
-            cv::minMaxLoc(scores, nullptr, &confidence, nullptr, &classIdPoint);
-            if (confidence > CONFIDENCE_THRESHOLD && (Combined_Condition)){
-                int centerX = (int)(data[0] * frame.cols);
-                int centerY = (int)(data[1] * frame.rows);
-                int width = (int)(data[2] * frame.cols);
-                int height = (int)(data[3] * frame.rows);
-                int left = centerX - width / 2;
-                int top = centerY - height / 2;
-
-                // classIds.push_back(classIdPoint.x);
-                confidences.push_back((float)confidence);
-                boxes.push_back(Rect(left, top, width, height));
-            }
-        }
-    }
+    // Person (0) and bicycle (1)
+    decodeYolo(outs, Rect(0, 0, frame.cols, frame.rows), CONFIDENCE_THRESHOLD, 2, boxes, classIds, confidences);
 
     vector<int> indices;
     NMSBoxes(boxes, confidences, CONFIDENCE_THRESHOLD, NMS_THRESHOLD, indices);
@@ -114,7 +89,8 @@ int main(int argc, char** argv) {
     }
     
     // Check if OpenCV is built with CUDA support and set CUDA as preferable backend and target
-    if (cuda::getCudaEnabledDeviceCount() > 0) {
+    bool cudaEnabled = cuda::getCudaEnabledDeviceCount() > 0;
+    if (cudaEnabled) {
         Facenet.setPreferableBackend(DNN_BACKEND_CUDA);
         Facenet.setPreferableTarget(DNN_TARGET_CUDA);
         Personnet.setPreferableBackend(DNN_BACKEND_CUDA);
@@ -143,6 +119,16 @@ int main(int argc, char** argv) {
 
 
     Mat frame, blob;
+    vector<Mat> personOuts, faceOuts;
+    vector<String> personOutNames = Personnet.getUnconnectedOutLayersNames();
+    vector<String> faceOutNames = Facenet.getUnconnectedOutLayersNames();
+    // On CUDA the face forward runs beside the person forward; on the CPU
+    // they run in a row, since a parallel_for_ started while OpenCV's single
+    // pool is busy runs on one thread.
+    ForwardWorker faceWorker([&](Mat &input, vector<Mat> &outs) {
+        Facenet.setInput(input);
+        Facenet.forward(outs, faceOutNames);
+    });
     double fps = 0.0;
     int frameCnt = 0;
     // double startTime = (double)getTickCount(); // start fps
@@ -151,14 +137,18 @@ int main(int argc, char** argv) {
     while (cap.read(frame)) {
         t = (double)getTickCount();
         blobFromImage(frame, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
-        Facenet.setInput(blob);
+        if (cudaEnabled) faceWorker.start(blob, faceOuts);
         Personnet.setInput(blob);
-        vector<Mat> outs;
-        Personnet.forward(outs, Personnet.getUnconnectedOutLayersNames());
-        postprocess(frame, outs);
+        Personnet.forward(personOuts, personOutNames);
+        if (cudaEnabled) {
+            faceWorker.wait();
+        } else {
+            Facenet.setInput(blob);
+            Facenet.forward(faceOuts, faceOutNames);
+        }
 
-        Facenet.forward(outs, Facenet.getUnconnectedOutLayersNames());
-        postprocess(frame, outs,true);
+        postprocess(frame, personOuts);
+        postprocess(frame, faceOuts,true);
 
         ++frameCnt;
         duration = (double)getTickCount() - t;
@@ -1,36 +1,69 @@
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 
+#include "lbp_operator.h"
+#include "skin_segmentation.h"
+
 using namespace cv;
 using namespace std;
 
-Mat convertToLBP(const Mat& src_gray) {
-    Mat lbpImg = src_gray.clone();
-    for (int i = 1; i < src_gray.rows - 1; i++) {
-        for (int j = 1; j < src_gray.cols - 1; j++) {
-            uchar center = src_gray.at<uchar>(i, j);
-            unsigned char lbp = 0;
-            lbp |= (src_gray.at<uchar>(i-1, j-1) > center) << 7;
-            lbp |= (src_gray.at<uchar>(i-1, j) > center) << 6;
-            lbp |= (src_gray.at<uchar>(i-1, j+1) > center) << 5;
-            lbp |= (src_gray.at<uchar>(i, j+1) > center) << 4;
-            lbp |= (src_gray.at<uchar>(i+1, j+1) > center) << 3;
-            lbp |= (src_gray.at<uchar>(i+1, j) > center) << 2;
-            lbp |= (src_gray.at<uchar>(i+1, j-1) > center) << 1;
-            lbp |= (src_gray.at<uchar>(i, j-1) > center) << 0;
-            lbpImg.at<uchar>(i, j) = lbp;
+// Accumulated time per pass, printed every REPORT_FRAMES frames with --timing.
+const int REPORT_FRAMES = 100;
+
+struct PassTimes {
+    vector<string> names;
+    vector<double> totals;
+    int64 last;
+    int frames;
+
+    PassTimes() : last(0), frames(0) {}
+
+    void start() { last = getTickCount(); }
+
+    void lap(const string &name) {
+        int64 now = getTickCount();
+        size_t i = find(names.begin(), names.end(), name) - names.begin();
+        if (i == names.size()) {
+            names.push_back(name);
+            totals.push_back(0.0);
         }
+        totals[i] += (now - last) * 1000.0 / getTickFrequency();
+        last = now;
     }
-    return lbpImg;
-}
+
+    void report(const string &path) {
+        double total = 0.0;
+        cout << "Per-pass ms per frame (" << path << "):";
+        for (size_t i = 0; i < names.size(); ++i) {
+            cout << " " << names[i] << " " << format("%.2f", totals[i] / frames);
+            total += totals[i];
+            totals[i] = 0.0;
+        }
+        cout << format("  total %.2f", total / frames) << endl;
+        frames = 0;
+    }
+};
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " <VideoPath>" << endl;
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " <VideoPath> [--fused [--scale N]] [--timing]" << endl;
         return -1;
     }
 
+    // --fused segments with one pass over the frame (see skin_segmentation.h),
+    // at 1/N of the resolution with --scale N.
+    bool fused = false, timing = false;
+    int scale = 1;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--fused") fused = true;
+        else if (arg == "--timing") timing = true;
+        else if (arg == "--scale" && i + 1 < argc) scale = max(1, atoi(argv[++i]));
+    }
+
     VideoCapture cap(argv[1]);
     if (!cap.isOpened()) {
         cout << "Error opening video stream or file" << endl;
@@ -40,32 +73,56 @@ int main(int argc, char** argv) {
     Mat frame, hsv, skinMask, gray, lbp;
     Ptr<CLAHE> clahe = createCLAHE();
     clahe->setClipLimit(4);
+    SkinSegmenter segmenter(fused ? scale : 1);
+    vector<vector<Point>> contours;
+    PassTimes times;
 
     while (cap.read(frame)) {
-        cvtColor(frame, gray, COLOR_BGR2GRAY);
-        clahe->apply(gray, gray);  // Apply CLAHE to normalize lighting variations
+        times.start();
+        if (fused) {
+            segmenter.segment(frame, gray, skinMask);
+            times.lap("segment");
+
+            clahe->apply(gray, gray);  // Apply CLAHE to normalize lighting variations
+            times.lap("clahe");
+        } else {
+            cvtColor(frame, gray, COLOR_BGR2GRAY);
+            times.lap("gray");
+            clahe->apply(gray, gray);  // Apply CLAHE to normalize lighting variations
+            times.lap("clahe");
 
-        cvtColor(frame, hsv, COLOR_BGR2HSV);
-        inRange(hsv, Scalar(0, 30, 60), Scalar(20, 150, 255), skinMask);
+            cvtColor(frame, hsv, COLOR_BGR2HSV);
+            times.lap("hsv");
+            inRange(hsv, Scalar(0, 30, 60), Scalar(20, 150, 255), skinMask);
+            times.lap("inRange");
 
-        // Morphological opening and closing to clean up the mask
-        morphologyEx(skinMask, skinMask, MORPH_OPEN, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
-        morphologyEx(skinMask, skinMask, MORPH_CLOSE, getStructuringElement(MORPH_ELLIPSE, Size(7, 7)));
+            // Morphological opening and closing to clean up the mask
+            morphologyEx(skinMask, skinMask, MORPH_OPEN, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
+            times.lap("open");
+            morphologyEx(skinMask, skinMask, MORPH_CLOSE, getStructuringElement(MORPH_ELLIPSE, Size(7, 7)));
+            times.lap("close");
+        }
 
-        lbp = convertToLBP(gray);
+        convertToLBP(gray, lbp);
+        times.lap("lbp");
         lbp &= skinMask;
+        times.lap("and");
 
-        vector<vector<Point>> contours;
         findContours(skinMask, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+        times.lap("contours");
 
         for (const auto& contour : contours) {
-            Rect rect = boundingRect(contour);
+            Rect rect = segmenter.toFrame(boundingRect(contour));
             float faceLikeRatio = static_cast<float>(rect.width) / rect.height;
             if (faceLikeRatio > 0.5 && faceLikeRatio < 1.5 && rect.area() > 1000) {
                 rectangle(frame, rect, Scalar(0, 255, 0), 2);
             }
         }
 
+        if (timing && ++times.frames == REPORT_FRAMES) {
+            times.report(fused ? format("fused, scale %d", segmenter.scale()) : "separate passes");
+        }
+
         imshow("Frame", frame);
         imshow("Skin Mask", skinMask);
         imshow("Masked LBP", lbp);
@@ -77,4 +134,3 @@ int main(int argc, char** argv) {
     destroyAllWindows();
     return 0;
 }
-
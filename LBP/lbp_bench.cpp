@@ -0,0 +1,70 @@
+// Speed of the vectorized, parallel convertToLBP against the original
+// scalar version at 720p, 1080p and 4K, with a bit-exactness check, plus
+// the cost of the uniform mapping and 8x8 block histograms.
+
+#include <opencv2/core.hpp>
+#include <chrono>
+#include <cstdio>
+#include "lbp_operator.h"
+
+using namespace cv;
+
+// The original implementation from lbp.cpp, kept as the reference.
+Mat referenceLBP(const Mat& src_gray) {
+    Mat lbpImg = src_gray.clone();
+    for (int i = 1; i < src_gray.rows - 1; i++) {
+        for (int j = 1; j < src_gray.cols - 1; j++) {
+            uchar center = src_gray.at<uchar>(i, j);
+            unsigned char lbp = 0;
+            lbp |= (src_gray.at<uchar>(i-1, j-1) > center) << 7;
+            lbp |= (src_gray.at<uchar>(i-1, j) > center) << 6;
+            lbp |= (src_gray.at<uchar>(i-1, j+1) > center) << 5;
+            lbp |= (src_gray.at<uchar>(i, j+1) > center) << 4;
+            lbp |= (src_gray.at<uchar>(i+1, j+1) > center) << 3;
+            lbp |= (src_gray.at<uchar>(i+1, j) > center) << 2;
+            lbp |= (src_gray.at<uchar>(i+1, j-1) > center) << 1;
+            lbp |= (src_gray.at<uchar>(i, j-1) > center) << 0;
+            lbpImg.at<uchar>(i, j) = lbp;
+        }
+    }
+    return lbpImg;
+}
+
+template <typename F>
+double timeMs(F f, int repeats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+int main() {
+    const Size sizes[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const int repeats = 20;
+    const int threads = getNumThreads();
+    RNG rng(12345);
+
+    printf("%-10s %12s %12s %12s %9s %14s %6s\n", "frame", "scalar ms", "1 thread ms", "parallel ms", "speedup",
+           "uniform+hist ms", "exact");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        Mat gray(sizes[s], CV_8UC1), reference, lbp, labels, histograms;
+        rng.fill(gray, RNG::UNIFORM, 0, 256);
+
+        double scalarMs = timeMs([&]() { reference = referenceLBP(gray); }, repeats);
+
+        setNumThreads(1);
+        double singleMs = timeMs([&]() { convertToLBP(gray, lbp); }, repeats);
+        setNumThreads(threads);
+        double parallelMs = timeMs([&]() { convertToLBP(gray, lbp); }, repeats);
+
+        double featureMs = timeMs([&]() {
+            uniformLBP(lbp, labels);
+            lbpHistograms(labels, Size(8, 8), UNIFORM_LBP_BINS, histograms);
+        }, repeats);
+
+        bool exact = norm(reference, lbp, NORM_INF) == 0;
+        printf("%4dx%-5d %12.3f %12.3f %12.3f %8.1fx %14.3f %6s\n", gray.cols, gray.rows, scalarMs, singleMs,
+               parallelMs, scalarMs / parallelMs, featureMs, exact ? "yes" : "NO");
+        if (!exact) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "lbp_operator.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+
+#define OPENCV_AT_LEAST(major, minor, revision) \
+    (CV_VERSION_MAJOR * 10000 + CV_VERSION_MINOR * 100 + CV_VERSION_REVISION >= (major) * 10000 + (minor) * 100 + (revision))
+
+#if CV_SIMD128
+// Universal intrinsics dropped the operator overloads in favour of named
+// functions in 4.9.
+static inline cv::v_uint8x16 brighter(const cv::v_uint8x16 &neighbour, const cv::v_uint8x16 &center) {
+#if OPENCV_AT_LEAST(4, 9, 0)
+    return cv::v_gt(neighbour, center);
+#else
+    return neighbour > center;
+#endif
+}
+
+static inline cv::v_uint8x16 setBit(const cv::v_uint8x16 &code, const cv::v_uint8x16 &test, const cv::v_uint8x16 &bit) {
+#if OPENCV_AT_LEAST(4, 9, 0)
+    return cv::v_or(code, cv::v_and(test, bit));
+#else
+    return code | (test & bit);
+#endif
+}
+#endif
+
+class LBPBody : public cv::ParallelLoopBody {
+public:
+    LBPBody(const cv::Mat &gray, cv::Mat &lbp) : gray(gray), lbp(lbp) {}
+
+    void operator()(const cv::Range &range) const {
+        const int width = gray.cols;
+#if CV_SIMD128
+        const cv::v_uint8x16 bits[8] = {
+            cv::v_setall_u8(1), cv::v_setall_u8(2), cv::v_setall_u8(4), cv::v_setall_u8(8),
+            cv::v_setall_u8(16), cv::v_setall_u8(32), cv::v_setall_u8(64), cv::v_setall_u8(128)
+        };
+#endif
+        for (int i = range.start; i < range.end; ++i) {
+            const uchar *above = gray.ptr<uchar>(i - 1);
+            const uchar *row = gray.ptr<uchar>(i);
+            const uchar *below = gray.ptr<uchar>(i + 1);
+            uchar *out = lbp.ptr<uchar>(i);
+
+            out[0] = row[0];
+            out[width - 1] = row[width - 1];
+
+            int j = 1;
+#if CV_SIMD128
+            for (; j + 16 <= width - 1; j += 16) {
+                cv::v_uint8x16 center = cv::v_load(row + j);
+                cv::v_uint8x16 code = cv::v_setzero_u8();
+                code = setBit(code, brighter(cv::v_load(above + j - 1), center), bits[7]);
+                code = setBit(code, brighter(cv::v_load(above + j), center), bits[6]);
+                code = setBit(code, brighter(cv::v_load(above + j + 1), center), bits[5]);
+                code = setBit(code, brighter(cv::v_load(row + j + 1), center), bits[4]);
+                code = setBit(code, brighter(cv::v_load(below + j + 1), center), bits[3]);
+                code = setBit(code, brighter(cv::v_load(below + j), center), bits[2]);
+                code = setBit(code, brighter(cv::v_load(below + j - 1), center), bits[1]);
+                code = setBit(code, brighter(cv::v_load(row + j - 1), center), bits[0]);
+                cv::v_store(out + j, code);
+            }
+#endif
+            for (; j < width - 1; ++j) {
+                uchar center = row[j];
+                out[j] = (uchar)(((above[j - 1] > center) << 7) | ((above[j] > center) << 6) |
+                                 ((above[j + 1] > center) << 5) | ((row[j + 1] > center) << 4) |
+                                 ((below[j + 1] > center) << 3) | ((below[j] > center) << 2) |
+                                 ((below[j - 1] > center) << 1) | (row[j - 1] > center));
+            }
+        }
+    }
+
+private:
+    const cv::Mat &gray;
+    cv::Mat &lbp;
+};
+
+void convertToLBP(const cv::Mat &gray, cv::Mat &lbp) {
+    CV_Assert(gray.type() == CV_8UC1);
+    lbp.create(gray.size(), CV_8UC1);
+    CV_Assert(lbp.data != gray.data);
+
+    if (gray.rows < 3 || gray.cols < 3) {
+        gray.copyTo(lbp);
+        return;
+    }
+    gray.row(0).copyTo(lbp.row(0));
+    gray.row(gray.rows - 1).copyTo(lbp.row(gray.rows - 1));
+
+    LBPBody body(gray, lbp);
+    cv::parallel_for_(cv::Range(1, gray.rows - 1), body, std::max(1, (gray.rows - 2) / 16));
+}
+
+cv::Mat convertToLBP(const cv::Mat &gray) {
+    cv::Mat lbp;
+    convertToLBP(gray, lbp);
+    return lbp;
+}
+
+// Code to uniform label table; built once.
+static const cv::Mat &uniformTable() {
+    static const cv::Mat table = [] {
+        cv::Mat t(1, 256, CV_8UC1);
+        int next = 0;
+        for (int code = 0; code < 256; ++code) {
+            int rotated = ((code << 1) | (code >> 7)) & 0xFF;
+            int transitions = 0;
+            for (int x = code ^ rotated; x; x &= x - 1) ++transitions;
+            t.at<uchar>(code) = (uchar)(transitions <= 2 ? next++ : UNIFORM_LBP_BINS - 1);
+        }
+        return t;
+    }();
+    return table;
+}
+
+void uniformLBP(const cv::Mat &lbp, cv::Mat &labels) {
+    CV_Assert(lbp.type() == CV_8UC1);
+    cv::LUT(lbp, uniformTable(), labels);
+}
+
+class HistogramBody : public cv::ParallelLoopBody {
+public:
+    HistogramBody(const cv::Mat &labels, const cv::Mat &mask, const cv::Size &grid, cv::Mat &histograms)
+        : labels(labels), mask(mask), grid(grid), histograms(histograms) {}
+
+    void operator()(const cv::Range &range) const {
+        for (int b = range.start; b < range.end; ++b) {
+            int bx = b % grid.width, by = b / grid.width;
+            int x0 = bx * labels.cols / grid.width, x1 = (bx + 1) * labels.cols / grid.width;
+            int y0 = by * labels.rows / grid.height, y1 = (by + 1) * labels.rows / grid.height;
+
+            float *hist = histograms.ptr<float>(b);
+            int bins = histograms.cols;
+            int counted = 0;
+            for (int y = y0; y < y1; ++y) {
+                const uchar *row = labels.ptr<uchar>(y);
+                const uchar *inside = mask.empty() ? 0 : mask.ptr<uchar>(y);
+                for (int x = x0; x < x1; ++x) {
+                    if (inside && !inside[x]) continue;
+                    if (row[x] < bins) {
+                        hist[row[x]] += 1.f;
+                        ++counted;
+                    }
+                }
+            }
+            if (counted > 0) {
+                float scale = 1.f / counted;
+                for (int k = 0; k < bins; ++k) hist[k] *= scale;
+            }
+        }
+    }
+
+private:
+    const cv::Mat &labels;
+    const cv::Mat &mask;
+    cv::Size grid;
+    cv::Mat &histograms;
+};
+
+void lbpHistograms(const cv::Mat &labels, const cv::Size &grid, int bins, cv::Mat &histograms, const cv::Mat &mask) {
+    CV_Assert(labels.type() == CV_8UC1 && grid.width > 0 && grid.height > 0 && bins > 0 && bins <= 256);
+    CV_Assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == labels.size()));
+
+    int blocks = grid.width * grid.height;
+    histograms.create(blocks, bins, CV_32F);
+    histograms.setTo(0);
+
+    HistogramBody body(labels, mask, grid, histograms);
+    cv::parallel_for_(cv::Range(0, blocks), body);
+}
@@ -0,0 +1,34 @@
+#ifndef LBP_OPERATOR_H
+#define LBP_OPERATOR_H
+
+#include <opencv2/core.hpp>
+
+// 8-neighbour local binary patterns. Bit 7 is the top-left neighbour and
+// the bits run clockwise down to bit 0 on the left; a bit is set when the
+// neighbour is strictly brighter than the center.
+
+// Number of labels produced by uniformLBP: the 58 uniform patterns plus
+// one shared label for all the others.
+const int UNIFORM_LBP_BINS = 59;
+
+// LBP codes of an 8-bit gray image into `lbp`, which must not alias `gray`.
+// The one-pixel border keeps the gray values, as the original clone-based
+// version did. Rows are split across OpenCV's thread pool and each row is
+// compared 16 pixels at a time with universal intrinsics.
+void convertToLBP(const cv::Mat &gray, cv::Mat &lbp);
+
+cv::Mat convertToLBP(const cv::Mat &gray);
+
+// Maps LBP codes to uniform-pattern labels: codes with at most two 0/1
+// transitions around the circle get labels 0..57 in code order, every
+// other code gets 58.
+void uniformLBP(const cv::Mat &lbp, cv::Mat &labels);
+
+// L1-normalized label histograms over a grid of equal blocks, one row of
+// `bins` floats per block in row-major block order, for use as a
+// classifier feature vector. Pixels outside `mask` (if given) are not
+// counted; a block with no counted pixels gets an all-zero row.
+void lbpHistograms(const cv::Mat &labels, const cv::Size &grid, int bins, cv::Mat &histograms,
+                   const cv::Mat &mask = cv::Mat());
+
+#endif
@@ -0,0 +1,98 @@
+#include "skin_segmentation.h"
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+// cvtColor's BGR2GRAY weights, scaled by 2^14.
+const int GRAY_B = 1868, GRAY_G = 9617, GRAY_R = 4899;
+const int GRAY_SHIFT = 14;
+
+// Structuring element sizes at full resolution, as in the original loop.
+const int OPEN_SIZE = 5;
+const int CLOSE_SIZE = 7;
+
+// inRange(hsv, (0, 30, 60), (20, 150, 255)) on rounded H (0..180) and S,
+// written without divisions:
+//   V >= 60
+//   round(255 * (V - min) / V) in [30, 150]  <=>  59 V <= 510 d < 301 V
+//   round(30 * (G - B) / d) in [0, 20] with R the maximum
+//                                            <=>  0 <= 60 (G - B) < 41 d
+static inline bool isSkin(int b, int g, int r) {
+    int v = std::max(r, std::max(g, b));
+    int d = v - std::min(r, std::min(g, b));
+    if (v < 60 || v != r) return false;
+    if (510 * d < 59 * v || 510 * d >= 301 * v) return false;
+    return g >= b && 60 * (g - b) < 41 * d;
+}
+
+class SegmentBody : public cv::ParallelLoopBody {
+public:
+    SegmentBody(const cv::Mat &frame, int stride, cv::Mat &gray, cv::Mat &mask)
+        : frame(frame), stride(stride), gray(gray), mask(mask) {}
+
+    void operator()(const cv::Range &range) const {
+        const int area = stride * stride;
+        for (int y = range.start; y < range.end; ++y) {
+            uchar *grayRow = gray.ptr<uchar>(y);
+            uchar *maskRow = mask.ptr<uchar>(y);
+
+            if (stride == 1) {
+                const uchar *p = frame.ptr<uchar>(y);
+                for (int x = 0; x < gray.cols; ++x, p += 3) {
+                    int b = p[0], g = p[1], r = p[2];
+                    grayRow[x] = (uchar)((b * GRAY_B + g * GRAY_G + r * GRAY_R + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+                    maskRow[x] = isSkin(b, g, r) ? 255 : 0;
+                }
+                continue;
+            }
+
+            for (int x = 0; x < gray.cols; ++x) {
+                int b = 0, g = 0, r = 0;
+                for (int dy = 0; dy < stride; ++dy) {
+                    const uchar *p = frame.ptr<uchar>(y * stride + dy) + x * stride * 3;
+                    for (int dx = 0; dx < stride; ++dx, p += 3) {
+                        b += p[0];
+                        g += p[1];
+                        r += p[2];
+                    }
+                }
+                b = (b + area / 2) / area;
+                g = (g + area / 2) / area;
+                r = (r + area / 2) / area;
+                grayRow[x] = (uchar)((b * GRAY_B + g * GRAY_G + r * GRAY_R + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+                maskRow[x] = isSkin(b, g, r) ? 255 : 0;
+            }
+        }
+    }
+
+private:
+    const cv::Mat &frame;
+    int stride;
+    cv::Mat &gray;
+    cv::Mat &mask;
+};
+
+// Odd kernel size for a full-resolution size at this stride, at least 3.
+static int scaledSize(int size, int stride) {
+    return std::max(3, (size / stride) | 1);
+}
+
+SkinSegmenter::SkinSegmenter(int stride) : stride(std::max(1, stride)) {
+    openKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE,
+                                           cv::Size(scaledSize(OPEN_SIZE, this->stride), scaledSize(OPEN_SIZE, this->stride)));
+    closeKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE,
+                                            cv::Size(scaledSize(CLOSE_SIZE, this->stride), scaledSize(CLOSE_SIZE, this->stride)));
+}
+
+void SkinSegmenter::segment(const cv::Mat &frame, cv::Mat &gray, cv::Mat &mask) {
+    CV_Assert(frame.type() == CV_8UC3);
+    cv::Size size(frame.cols / stride, frame.rows / stride);
+    gray.create(size, CV_8UC1);
+    mask.create(size, CV_8UC1);
+
+    SegmentBody body(frame, stride, gray, mask);
+    cv::parallel_for_(cv::Range(0, size.height), body, std::max(1, size.height / 16));
+
+    cv::morphologyEx(mask, mask, cv::MORPH_OPEN, openKernel);
+    cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, closeKernel);
+}
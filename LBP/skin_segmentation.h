@@ -0,0 +1,37 @@
+#ifndef SKIN_SEGMENTATION_H
+#define SKIN_SEGMENTATION_H
+
+#include <opencv2/core.hpp>
+
+// Gray image and skin mask of a BGR frame in one pass, replacing
+// cvtColor(GRAY) + cvtColor(HSV) + inRange, followed by the opening and
+// closing with structuring elements built once.
+//
+// The skin test is the HSV range H 0..20, S 30..150, V >= 60 evaluated
+// directly on B, G and R with integer arithmetic; no HSV image is written.
+// Gray uses the BT.601 weights in 14-bit fixed point. cvtColor's
+// table-based HSV rounding can be one level off from exact rounding, so
+// the two only disagree on colors at a range boundary.
+//
+// With a stride above 1 every output pixel is the mean of a stride x stride
+// block of the frame, so a stride of 2 reads the frame once and writes a
+// quarter of the pixels. Rows are split into bands across the thread pool.
+class SkinSegmenter {
+public:
+    explicit SkinSegmenter(int stride = 1);
+
+    // Fills `gray` and `mask` (both CV_8UC1, frame size / stride) from an
+    // 8-bit BGR frame; `mask` is already cleaned up.
+    void segment(const cv::Mat &frame, cv::Mat &gray, cv::Mat &mask);
+
+    // Scales a rectangle of the segmented images back to frame coordinates.
+    cv::Rect toFrame(const cv::Rect &r) const { return cv::Rect(r.x * stride, r.y * stride, r.width * stride, r.height * stride); }
+
+    int scale() const { return stride; }
+
+private:
+    int stride;
+    cv::Mat openKernel, closeKernel;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "alloc_counter.h"
+
+#include <iostream>
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+#include <opencv2/core.hpp>
+
+namespace {
+
+// Trivially initialized, so operator new can use it on any thread.
+thread_local long long allocations = 0;
+
+// Counts real buffer allocations and forwards everything to the default
+// allocator; Mats that wrap user data are not counted.
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    CountingMatAllocator() : base(cv::Mat::getStdAllocator()) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const {
+        if (!data) ++allocations;
+        return base->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const {
+        return base->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const {
+        base->deallocate(data);
+    }
+
+private:
+    cv::MatAllocator* base;
+};
+
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+long long threadAllocationCount() {
+    return allocations;
+}
+
+void installAllocationCounter() {
+    static CountingMatAllocator allocator;
+    cv::Mat::setDefaultAllocator(&allocator);
+}
+
+#else
+
+long long threadAllocationCount() {
+    return -1;
+}
+
+void installAllocationCounter() {
+}
+
+#endif
+
+AllocationCheck::AllocationCheck(const std::string &loop, long warmupFrames)
+    : loop(loop), warmupFrames(warmupFrames), frames(0), allocating(0), start(0) {}
+
+void AllocationCheck::beginFrame() {
+    start = threadAllocationCount();
+}
+
+bool AllocationCheck::endFrame(long long excluded) {
+    if (start < 0) return true;
+    long long count = threadAllocationCount() - start - excluded;
+    if (++frames <= warmupFrames || count == 0) return true;
+    if (++allocating <= 10 || allocating % 100 == 0) {
+        std::cerr << loop << ": frame " << frames << " made " << count << " allocations after warm-up" << std::endl;
+    }
+    return false;
+}
+
+bool AllocationCheck::report() const {
+    if (threadAllocationCount() < 0) return true;
+    long checked = frames > warmupFrames ? frames - warmupFrames : 0;
+    std::cerr << loop << ": " << allocating << " of " << checked << " frames after warm-up allocated" << std::endl;
+    return allocating == 0;
+}
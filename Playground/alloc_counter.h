@@ -0,0 +1,45 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <string>
+
+// Debug allocation counter, built in with `make COUNT_ALLOCATIONS=1`. It
+// counts operator new calls and cv::Mat buffer allocations so a loop can
+// show that its steady state does not allocate.
+
+// Allocations made by the calling thread since it started, or -1 when
+// counting is compiled out. Other threads (capture, encoder, a second
+// forward, OpenCV's parallel_for_ workers) are not included, so a pipeline
+// stage can be checked while the others allocate.
+long long threadAllocationCount();
+
+// Routes cv::Mat allocations through the counter; no-op when compiled out.
+void installAllocationCounter();
+
+// Per-frame check for a loop that should stop allocating once warmed up.
+// Frames after the first `warmupFrames` that still allocate are reported on
+// stderr (the first ten, then every hundredth) and counted. Does nothing
+// when counting is compiled out.
+class AllocationCheck {
+public:
+    AllocationCheck(const std::string &loop, long warmupFrames);
+
+    void beginFrame();
+
+    // `excluded` allocations, such as those of the DNN forward, are not
+    // held against the frame. False if a warmed-up frame allocated.
+    bool endFrame(long long excluded = 0);
+
+    // Prints e.g. "playground: 0 of 900 frames after warm-up allocated" on
+    // stderr. False if any warmed-up frame allocated, so a debug run can
+    // fail on it.
+    bool report() const;
+
+private:
+    std::string loop;
+    long warmupFrames;
+    long frames, allocating;
+    long long start;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "anonymize.h"
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+// Faces processed on the calling thread below this count; the
+// parallel_for_ dispatch costs more than a few small blurs.
+const size_t PARALLEL_MIN_FACES = 4;
+
+// Pixelation grid across the longer side of the face.
+const int PIXELATE_CELLS = 8;
+
+// Box blur radius as a fraction of the longer side of the face.
+const int BOX_RADIUS_DIVISOR = 6;
+
+const cv::Scalar FILL_COLOR(128, 128, 128);
+
+static AnonymizeMethod currentFaceAnonymizer = ANONYMIZE_GAUSSIAN;
+
+static const char* const METHOD_NAMES[ANONYMIZE_METHOD_COUNT] = {"gaussian", "pixelate", "box", "fill"};
+
+bool parseAnonymizeMethod(const std::string &name, AnonymizeMethod &method) {
+    for (int i = 0; i < ANONYMIZE_METHOD_COUNT; ++i) {
+        if (name == METHOD_NAMES[i]) {
+            method = (AnonymizeMethod)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* anonymizeMethodName(AnonymizeMethod method) {
+    return METHOD_NAMES[method];
+}
+
+void setFaceAnonymizer(AnonymizeMethod method) {
+    currentFaceAnonymizer = method;
+}
+
+AnonymizeMethod faceAnonymizer() {
+    return currentFaceAnonymizer;
+}
+
+static void pixelate(cv::Mat &roi) {
+    // Per thread, so parallel faces do not share the buffer.
+    static thread_local cv::Mat small;
+    int cell = std::max(1, std::max(roi.cols, roi.rows) / PIXELATE_CELLS);
+    cv::Size grid((roi.cols + cell - 1) / cell, (roi.rows + cell - 1) / cell);
+    cv::resize(roi, small, grid, 0, 0, cv::INTER_AREA);
+    cv::resize(small, roi, roi.size(), 0, 0, cv::INTER_NEAREST);
+}
+
+// Mean over a (2r+1)^2 window, shrunk at the edges of the region, read
+// from an integral image so the cost per pixel does not grow with r.
+static void integralBoxBlur(cv::Mat &roi) {
+    static thread_local cv::Mat sum;
+    CV_Assert(roi.depth() == CV_8U);
+    int r = std::max(2, std::max(roi.cols, roi.rows) / BOX_RADIUS_DIVISOR);
+    int cn = roi.channels();
+    cv::integral(roi, sum, CV_32S);
+
+    for (int y = 0; y < roi.rows; ++y) {
+        int y0 = std::max(0, y - r), y1 = std::min(roi.rows, y + r + 1);
+        const int *top = sum.ptr<int>(y0), *bottom = sum.ptr<int>(y1);
+        uchar *out = roi.ptr<uchar>(y);
+        for (int x = 0; x < roi.cols; ++x) {
+            int x0 = std::max(0, x - r) * cn, x1 = std::min(roi.cols, x + r + 1) * cn;
+            int area = (y1 - y0) * (x1 - x0) / cn;
+            for (int c = 0; c < cn; ++c) {
+                int s = bottom[x1 + c] - bottom[x0 + c] - top[x1 + c] + top[x0 + c];
+                out[x * cn + c] = (uchar)((s + area / 2) / area);
+            }
+        }
+    }
+}
+
+void anonymizeRegion(cv::Mat &frame, const cv::Rect &box, AnonymizeMethod method) {
+    cv::Rect clipped = box & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (clipped.empty()) return;
+
+    cv::Mat roi = frame(clipped);
+    switch (method) {
+    case ANONYMIZE_GAUSSIAN:
+        cv::GaussianBlur(roi, roi, cv::Size(31, 31), 13.0, 13.0);
+        break;
+    case ANONYMIZE_PIXELATE:
+        pixelate(roi);
+        break;
+    case ANONYMIZE_BOX:
+        integralBoxBlur(roi);
+        break;
+    default:
+        roi.setTo(FILL_COLOR);
+        break;
+    }
+}
+
+class AnonymizeBody : public cv::ParallelLoopBody {
+public:
+    AnonymizeBody(cv::Mat &frame, const std::vector<cv::Rect> &boxes, AnonymizeMethod method)
+        : frame(frame), boxes(boxes), method(method) {}
+
+    void operator()(const cv::Range &range) const {
+        for (int i = range.start; i < range.end; ++i) {
+            anonymizeRegion(frame, boxes[i], method);
+        }
+    }
+
+private:
+    cv::Mat &frame;
+    const std::vector<cv::Rect> &boxes;
+    AnonymizeMethod method;
+};
+
+// Overlapping faces would be read and written by two threads at once.
+// The Gaussian also reads `margin` pixels around its region, since a
+// region of the frame is not blurred in isolation.
+static bool anyOverlap(const std::vector<cv::Rect> &boxes, int margin) {
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        cv::Rect grown(boxes[i].x - margin, boxes[i].y - margin, boxes[i].width + 2 * margin, boxes[i].height + 2 * margin);
+        for (size_t j = i + 1; j < boxes.size(); ++j) {
+            if ((grown & boxes[j]).area() > 0) return true;
+        }
+    }
+    return false;
+}
+
+void anonymizeRegions(cv::Mat &frame, const std::vector<cv::Rect> &boxes, AnonymizeMethod method) {
+    AnonymizeBody body(frame, boxes, method);
+    int margin = method == ANONYMIZE_GAUSSIAN ? 15 : 0;
+    if (boxes.size() >= PARALLEL_MIN_FACES && !anyOverlap(boxes, margin))
+        cv::parallel_for_(cv::Range(0, (int)boxes.size()), body);
+    else
+        body(cv::Range(0, (int)boxes.size()));
+}
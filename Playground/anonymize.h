@@ -0,0 +1,35 @@
+#ifndef ANONYMIZE_H
+#define ANONYMIZE_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// Face anonymization kernels. Every method works in place on a region of
+// the frame, clipped to the frame first, so faces that touch the border
+// are still covered.
+enum AnonymizeMethod {
+    ANONYMIZE_GAUSSIAN,   // 31x31 Gaussian, sigma 13 (the original blur)
+    ANONYMIZE_PIXELATE,   // area downscale to a coarse grid, nearest upscale
+    ANONYMIZE_BOX,        // box blur from an integral image; cost independent of radius
+    ANONYMIZE_FILL,       // solid fill
+    ANONYMIZE_METHOD_COUNT
+};
+
+// "gaussian", "pixelate", "box" or "fill"; returns false for anything else.
+bool parseAnonymizeMethod(const std::string&, AnonymizeMethod&);
+
+const char* anonymizeMethodName(AnonymizeMethod);
+
+void anonymizeRegion(cv::Mat&, const cv::Rect&, AnonymizeMethod);
+
+// Anonymizes every box; with several non-overlapping boxes they are
+// processed in parallel.
+void anonymizeRegions(cv::Mat&, const std::vector<cv::Rect>&, AnonymizeMethod);
+
+// Method used by blurFaces and the face path of drawDetections.
+void setFaceAnonymizer(AnonymizeMethod);
+
+AnonymizeMethod faceAnonymizer();
+
+#endif
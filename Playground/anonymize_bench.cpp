@@ -0,0 +1,51 @@
+// Per-method timing of the face anonymization kernels on a 1080p frame,
+// for a few face counts, sequential and with the parallel path.
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <chrono>
+#include <cstdio>
+#include "anonymize.h"
+
+// Non-overlapping faces on a grid of 220x220 cells, 40 to 200 pixels wide.
+void makeFaces(int n, cv::RNG &rng, std::vector<cv::Rect> &faces) {
+    faces.clear();
+    for (int i = 0; i < n; ++i) {
+        int cellX = (i % 8) * 220, cellY = (i / 8) * 220;
+        int side = rng.uniform(40, 200);
+        faces.push_back(cv::Rect(cellX + rng.uniform(0, 220 - side), cellY + rng.uniform(0, 220 - side), side, side));
+    }
+}
+
+template <typename F>
+double timeMs(F f, int repeats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+int main() {
+    const int counts[] = {1, 8, 32};
+    const int repeats = 50;
+    cv::RNG rng(12345);
+
+    cv::Mat frame(1080, 1920, CV_8UC3);
+    rng.fill(frame, cv::RNG::UNIFORM, 0, 256);
+    std::vector<cv::Rect> faces;
+
+    printf("%-10s %6s %14s %14s\n", "method", "faces", "sequential ms", "parallel ms");
+    for (int m = 0; m < ANONYMIZE_METHOD_COUNT; ++m) {
+        AnonymizeMethod method = (AnonymizeMethod)m;
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+            makeFaces(counts[c], rng, faces);
+
+            double sequentialMs = timeMs([&]() {
+                for (size_t i = 0; i < faces.size(); ++i) anonymizeRegion(frame, faces[i], method);
+            }, repeats);
+            double parallelMs = timeMs([&]() { anonymizeRegions(frame, faces, method); }, repeats);
+
+            printf("%-10s %6d %14.3f %14.3f\n", anonymizeMethodName(method), counts[c], sequentialMs, parallelMs);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+// Headless benchmark: replays a video through the driver-view code path in
+// utilities.cpp and reports per-stage latency percentiles and throughput.
+
+#include "utilities.h"
+#include "latency.h"
+#include <fstream>
+
+enum Stage { DECODE, MASK, BLOB, PERSON_FORWARD, FACE_FORWARD, GET_BOXES, NMS, BLUR, ANNOTATE, TOTAL, STAGE_COUNT };
+
+const char* stageNames[STAGE_COUNT] = {
+    "decode", "maskFrame", "blobFromImage", "person_forward", "face_forward",
+    "getBoxes", "nms", "blur", "annotate", "total"
+};
+
+// `text` as a quoted JSON string; paths can hold quotes, backslashes and
+// control characters.
+static std::string jsonString(const std::string &text) {
+    std::string quoted = "\"";
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+int main(int argc, char** argv) {
+
+    if(argc < 2){
+        std::cerr << "Usage: "<< argv[0] << " <video_file_path> [--warmup N] [--frames N] [--json output.json] [--roi-crop] [--fused-preprocess [--letterbox]] [--anonymize gaussian|pixelate|box|fill] [--precision fp32|fp16|int8 [--calibration DIR]] [--models DIR]"<<std::endl;
+        return -1;
+    }
+
+    VideoCapture cap(argv[1]);
+    if(!cap.isOpened()) {
+        std::cerr <<"Could not open video"<<argv[1]<<std::endl;
+        return -1;
+    }
+
+    int warmup = intOption(argc, argv, "--warmup", 20);
+    int measured = intOption(argc, argv, "--frames", 300);
+    if (warmup < 0 || measured < 1) {
+        std::cerr << "--warmup must be at least 0 and --frames at least 1" << std::endl;
+        return -1;
+    }
+    std::string jsonPath = stringOption(argc, argv, "--json", "");
+    bool roiCrop = hasFlag(argc, argv, "--roi-crop");
+    bool fused = hasFlag(argc, argv, "--fused-preprocess");
+    bool letterbox = hasFlag(argc, argv, "--letterbox");
+
+    AnonymizeMethod anonymizer;
+    if (!parseAnonymizeMethod(stringOption(argc, argv, "--anonymize", "gaussian"), anonymizer)) {
+        std::cerr << "--anonymize must be gaussian, pixelate, box or fill" << std::endl;
+        return -1;
+    }
+    setFaceAnonymizer(anonymizer);
+
+    setModelDirectory(stringOption(argc, argv, "--models", "."));
+    if (!loadNetworks(true, true)) return -1;
+    if (!applyPrecisionOption(argc, argv, true, true)) return -1;
+
+    std::vector<LatencyHistogram> stages;
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        stages.push_back(LatencyHistogram(stageNames[i]));
+        stages.back().reserve(measured);
+    }
+
+    Mat frame, maskedFrame, blob;
+    FovMask fov;
+    Rect region;
+    PreprocessPlan plan;
+    vector<Mat> personOuts, faceOuts;
+    vector<Rect> boxes;
+    vector<int> classIds, indices;
+    vector<float> confidences;
+    double ms[STAGE_COUNT];
+    double measuredSeconds = 0.0;
+
+    for (int n = 0; n < warmup + measured; ++n) {
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point t = frameStart;
+
+        if(!cap.read(frame)) {
+            // Replay from the start so short clips can still fill the run.
+            cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+            if(!cap.read(frame)) {
+                std::cerr << "Could not read a frame from " << argv[1] << std::endl;
+                return -1;
+            }
+        }
+        ms[DECODE] = lapMs(t);
+
+        maskFrame(frame, maskedFrame, fov);
+        region = roiCrop ? fov.bounds : Rect(0, 0, frame.cols, frame.rows);
+        ms[MASK] = lapMs(t);
+
+        if (fused) {
+            // The covered rectangle is relative to the crop.
+            Rect covered = preprocessFrame(maskedFrame(region), Size(NETWORK_WIDTH, NETWORK_HEIGHT), letterbox, plan, blob);
+            region = covered + region.tl();
+        } else {
+            blobFromImage(maskedFrame(region), blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+        }
+        ms[BLOB] = lapMs(t);
+
+        detectPeople(blob, personOuts);
+        ms[PERSON_FORWARD] = lapMs(t);
+
+        detectFaces(blob, faceOuts);
+        ms[FACE_FORWARD] = lapMs(t);
+
+        ms[GET_BOXES] = ms[NMS] = ms[BLUR] = ms[ANNOTATE] = 0.0;
+        for (int faceProcess = 0; faceProcess < 2; ++faceProcess) {
+            boxes.clear();
+            classIds.clear();
+            confidences.clear();
+
+            getBoxes(faceProcess ? faceOuts : personOuts, boxes, region, classIds, confidences);
+            ms[GET_BOXES] += lapMs(t);
+
+            classAwareNMS(boxes, confidences, classIds,
+                          NmsParams(faceProcess ? FACE_CONFIDENCE_THRESHOLD : CONFIDENCE_THRESHOLD, NMS_THRESHOLD), indices);
+            ms[NMS] += lapMs(t);
+
+            for (int idx : indices) {
+                if (faceProcess) {
+                    blurFaces(boxes[idx], frame);
+                } else {
+                    annotate(classIds[idx], confidences[idx], boxes[idx], frame, true);
+                }
+            }
+            ms[faceProcess ? BLUR : ANNOTATE] += lapMs(t);
+        }
+
+        ms[TOTAL] = lapMs(frameStart);
+        if (n < warmup) continue;
+
+        measuredSeconds += ms[TOTAL] / 1000.0;
+        for (int i = 0; i < STAGE_COUNT; ++i) {
+            stages[i].add(ms[i]);
+        }
+    }
+
+    double throughput = measured / measuredSeconds;
+
+    printf("%-16s %8s %8s %8s %8s %8s\n", "stage", "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        printf("%-16s %8.3f %8.3f %8.3f %8.3f %8.3f\n", stages[i].getName().c_str(), stages[i].mean(),
+               stages[i].percentile(50), stages[i].percentile(90), stages[i].percentile(99), stages[i].max());
+    }
+    printf("Throughput: %.2f frames/s over %d frames (%d warm-up)\n", throughput, measured, warmup);
+
+    if (!jsonPath.empty()) {
+        std::ofstream json(jsonPath.c_str());
+        json << "{\n  \"video\": " << jsonString(argv[1]) << ",\n";
+        json << "  \"warmup_frames\": " << warmup << ",\n";
+        json << "  \"measured_frames\": " << measured << ",\n";
+        json << "  \"roi_crop\": " << (roiCrop ? "true" : "false") << ",\n";
+        json << "  \"preprocess\": \"" << (fused ? (letterbox ? "fused_letterbox" : "fused") : "blobFromImage") << "\",\n";
+        json << "  \"anonymize\": \"" << anonymizeMethodName(anonymizer) << "\",\n";
+        json << "  \"precision\": \"" << stringOption(argc, argv, "--precision", "fp32") << "\",\n";
+        json << "  \"throughput_fps\": " << throughput << ",\n";
+        json << "  \"stages\": [\n";
+        for (int i = 0; i < STAGE_COUNT; ++i) {
+            json << "    " << stages[i].toJson() << (i + 1 < STAGE_COUNT ? ",\n" : "\n");
+        }
+        json << "  ]\n}\n";
+    }
+
+    cap.release();
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Writes the INT8 calibration set: frames sampled evenly from recorded
+// videos, resized to the network input and saved as PNG. `--precision int8
+// --calibration DIR` quantizes both networks over these frames at startup.
+
+#include "utilities.h"
+#include <opencv2/core/utils/filesystem.hpp>
+
+int main(int argc, char** argv) {
+
+    std::vector<std::string> videos;
+    for (int i = 2; i < argc; ++i) {
+        if (std::string(argv[i]) == "--frames") {
+            ++i;
+            continue;
+        }
+        videos.push_back(argv[i]);
+    }
+
+    if(argc < 3 || videos.empty()){
+        std::cerr << "Usage: "<< argv[0] << " <output_dir> <video_file_path> [<video_file_path> ...] [--frames N]"<<std::endl;
+        return -1;
+    }
+
+    std::string outputDir = argv[1];
+    int total = intOption(argc, argv, "--frames", 64);
+    cv::utils::fs::createDirectories(outputDir);
+
+    int written = 0;
+    cv::Mat frame, resized;
+    for (size_t v = 0; v < videos.size(); ++v) {
+        VideoCapture cap(videos[v]);
+        if(!cap.isOpened()) {
+            std::cerr <<"Could not open video"<<videos[v]<<std::endl;
+            return -1;
+        }
+
+        // Spread this video's share of the set over its whole length.
+        int share = (total - written) / (int)(videos.size() - v);
+        double length = cap.get(cv::CAP_PROP_FRAME_COUNT);
+        double step = share > 0 && length > share ? length / share : 1.0;
+
+        for (int k = 0; k < share; ++k) {
+            cap.set(cv::CAP_PROP_POS_FRAMES, k * step);
+            if (!cap.read(frame)) break;
+
+            // Same resize blobFromImage does, so the stored frame gives the
+            // network exactly the input it would have seen.
+            cv::resize(frame, resized, Size(NETWORK_WIDTH, NETWORK_HEIGHT));
+            cv::imwrite(format("%s/calib_%04d.png", outputDir.c_str(), written), resized);
+            ++written;
+        }
+    }
+
+    std::cerr << "Wrote " << written << " calibration frames to " << outputDir << std::endl;
+    return written > 0 ? 0 : -1;
+}
@@ -0,0 +1,369 @@
+// Long-running detection service for several cameras. Every source has its
+// own capture thread and mode; frames from all of them are served by one
+// pool of inference workers, each with a private copy of the networks.
+//
+//   ./detection_daemon overhead:crossing.mp4 driver:dashcam.mp4 blur:/dev/video0
+//
+// Workers take streams round-robin and never hold two frames of the same
+// stream at once, so a busy camera cannot starve the others and every
+// stream is processed in order. File sources block when their queue is
+// full (nothing is skipped); live sources drop their oldest frame instead.
+
+#include "utilities.h"
+#include "metrics.h"
+#include "threaded_capture.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+enum StreamMode {
+    MODE_DRIVER,    // field-of-view mask, people and faces, driver warnings
+    MODE_OVERHEAD,  // people and faces
+    MODE_BLUR       // faces only
+};
+
+struct Stream {
+    Stream() : mode(MODE_OVERHEAD), live(false), head(0), count(0), busy(false), finished(false),
+               fresh(false), captured(0), processed(0), dropped(0), reported(0) {}
+
+    std::string path;
+    StreamMode mode;
+    bool live;
+    VideoCapture cap;
+
+    // Guarded by Daemon::lock.
+    std::vector<cv::Mat> ring;
+    size_t head, count;
+    bool busy;          // a worker holds a frame of this stream
+    bool finished;      // capture has ended
+    cv::Mat display;    // last processed frame, for the window
+    bool fresh;
+
+    // Only touched by the worker that holds the stream.
+    FovMask fov;
+    cv::Mat maskedFrame;
+
+    std::atomic<long> captured, processed, dropped;
+    long reported;
+};
+
+struct Daemon {
+    Daemon() : cursor(0), stopping(false), activeWorkers(0) {}
+
+    std::vector<Stream> streams;
+    std::mutex lock;
+    std::condition_variable work;    // a frame was queued or a stream freed
+    std::condition_variable space;   // a slot was freed in some ring
+    size_t cursor;                   // round-robin start for the next pick
+    bool stopping;
+    int activeWorkers;
+};
+
+// Served with --metrics-port; see metrics.h. Network, detection and blur
+// counts come from utilities.cpp.
+static const int preprocessSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                                     latencyBuckets(), "stage=\"preprocess\"");
+static const int postprocessSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                                      latencyBuckets(), "stage=\"postprocess\"");
+static const int frameSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                                latencyBuckets(), "stage=\"frame\"");
+
+bool parseSource(const std::string &spec, Stream &stream) {
+    size_t colon = spec.find(':');
+    std::string mode = colon == std::string::npos ? "" : spec.substr(0, colon);
+    if (mode == "driver") stream.mode = MODE_DRIVER;
+    else if (mode == "overhead") stream.mode = MODE_OVERHEAD;
+    else if (mode == "blur") stream.mode = MODE_BLUR;
+    else return false;
+
+    stream.path = spec.substr(colon + 1);
+    // Cameras and network streams keep running whether we keep up or not.
+    stream.live = isLiveSource(stream.path);
+    return true;
+}
+
+void captureStream(Daemon &daemon, Stream &stream, long maxFrames) {
+    int frame_drop_limit = 100;
+    cv::Mat frame;
+
+    while (frame_drop_limit && (maxFrames <= 0 || stream.captured.load() < maxFrames)) {
+        if (!stream.cap.read(frame)) {
+            frame_drop_limit--;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(daemon.lock);
+        if (stream.count == stream.ring.size()) {
+            if (stream.live) {
+                stream.head = (stream.head + 1) % stream.ring.size();
+                stream.count--;
+                stream.dropped++;
+            } else {
+                daemon.space.wait(guard, [&] { return daemon.stopping || stream.count < stream.ring.size(); });
+            }
+        }
+        if (daemon.stopping) break;
+
+        cv::swap(frame, stream.ring[(stream.head + stream.count) % stream.ring.size()]);
+        stream.count++;
+        stream.captured++;
+        daemon.work.notify_one();
+    }
+
+    std::lock_guard<std::mutex> guard(daemon.lock);
+    stream.finished = true;
+    daemon.work.notify_all();
+}
+
+// Next stream with a queued frame that no other worker holds, searching
+// from the round-robin cursor; -1 if none.
+int pickStream(Daemon &daemon) {
+    size_t n = daemon.streams.size();
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = (daemon.cursor + k) % n;
+        Stream &stream = daemon.streams[i];
+        if (!stream.busy && stream.count > 0) return (int)i;
+    }
+    return -1;
+}
+
+bool allDrained(Daemon &daemon) {
+    for (size_t i = 0; i < daemon.streams.size(); ++i) {
+        const Stream &stream = daemon.streams[i];
+        if (!stream.finished || stream.count > 0 || stream.busy) return false;
+    }
+    return true;
+}
+
+void processFrame(DetectorNets &nets, FrameContext &ctx, Stream &stream, cv::Mat &frame) {
+    ScopedMetricTimer frameTimer(frameSeconds);
+    ctx.beginFrame();
+    cv::Mat &input = stream.mode == MODE_DRIVER ? stream.maskedFrame : frame;
+    {
+        ScopedMetricTimer timer(preprocessSeconds);
+        if (stream.mode == MODE_DRIVER) {
+            maskFrame(frame, stream.maskedFrame, stream.fov);
+        }
+        blobFromImage(input, ctx.blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+    }
+
+    // Both forwards read only the blob, so drawing can wait until after them.
+    if (stream.mode != MODE_BLUR) {
+        detectPeople(nets, ctx.blob, ctx.personOuts);
+    }
+    detectFaces(nets, ctx.blob, ctx.faceOuts);
+
+    ScopedMetricTimer timer(postprocessSeconds);
+    if (stream.mode != MODE_BLUR) {
+        postProcess(frame, ctx.personOuts, false, stream.mode == MODE_DRIVER, ctx);
+    }
+    postProcess(frame, ctx.faceOuts, true, false, ctx);
+}
+
+void inferenceWorker(Daemon &daemon, int id, bool person, int warmupRuns) {
+    DetectorNets nets;
+    FrameContext ctx;
+    cv::Mat frame;
+
+    if (!loadDetectorNets(nets, person, true)) {
+        std::cerr << "Worker " << id << " could not load the networks" << std::endl;
+        std::lock_guard<std::mutex> guard(daemon.lock);
+        daemon.activeWorkers--;
+        daemon.work.notify_all();
+        return;
+    }
+    warmUpDetectorNets(nets, warmupRuns);
+
+    std::unique_lock<std::mutex> guard(daemon.lock);
+    while (true) {
+        int index = -1;
+        daemon.work.wait(guard, [&] {
+            if (daemon.stopping) return true;
+            index = pickStream(daemon);
+            return index >= 0 || allDrained(daemon);
+        });
+        if (index < 0) break;
+
+        daemon.cursor = index + 1;
+        Stream &stream = daemon.streams[index];
+        cv::swap(frame, stream.ring[stream.head]);
+        stream.head = (stream.head + 1) % stream.ring.size();
+        stream.count--;
+        stream.busy = true;
+        daemon.space.notify_all();
+        guard.unlock();
+
+        processFrame(nets, ctx, stream, frame);
+        reportFirstDetection();
+
+        guard.lock();
+        cv::swap(frame, stream.display);
+        stream.fresh = true;
+        stream.busy = false;
+        stream.processed++;
+        daemon.work.notify_all();
+    }
+    daemon.activeWorkers--;
+    daemon.work.notify_all();
+}
+
+void printRates(Daemon &daemon, double seconds) {
+    std::lock_guard<std::mutex> guard(daemon.lock);
+    size_t active = 0;
+    for (size_t i = 0; i < daemon.streams.size(); ++i) {
+        Stream &stream = daemon.streams[i];
+        long processed = stream.processed.load();
+        if (!stream.finished) active++;
+        std::cerr << format("  [%zu] %-40s %6.2f fps  captured %ld  processed %ld  dropped %ld",
+                            i, stream.path.c_str(), (processed - stream.reported) / seconds,
+                            stream.captured.load(), processed, stream.dropped.load()) << std::endl;
+        stream.reported = processed;
+    }
+    std::cerr << format("%zu of %zu streams active", active, daemon.streams.size()) << std::endl;
+}
+
+void usage(const char* name) {
+    std::cerr << "Usage: " << name << " <mode:source> [<mode:source> ...] [--workers N] [--queue-depth N]"
+              << " [--max-frames N] [--headless] [--models DIR] [--warmup-runs N] [--metrics-port N]\n"
+              << "  mode is driver, overhead or blur; source is a video file, /dev/videoN, rtsp://... or a camera index"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+    Daemon daemon;
+    std::vector<std::string> specs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--workers" || arg == "--queue-depth" || arg == "--max-frames" || arg == "--models" ||
+            arg == "--warmup-runs" || arg == "--metrics-port") {
+            ++i;
+            continue;
+        }
+        if (arg == "--headless") continue;
+        specs.push_back(arg);
+    }
+
+    int workers = intOption(argc, argv, "--workers", 2);
+    int queueDepth = intOption(argc, argv, "--queue-depth", 2);
+    long maxFrames = intOption(argc, argv, "--max-frames", 0);
+    bool headless = hasFlag(argc, argv, "--headless");
+    int warmupRuns = intOption(argc, argv, "--warmup-runs", 1);
+    int metricsPort = intOption(argc, argv, "--metrics-port", 0);
+    setModelDirectory(stringOption(argc, argv, "--models", "."));
+    if (specs.empty() || workers < 1 || queueDepth < 1) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    daemon.streams = std::vector<Stream>(specs.size());
+    for (size_t i = 0; i < specs.size(); ++i) {
+        Stream &stream = daemon.streams[i];
+        if (!parseSource(specs[i], stream)) {
+            usage(argv[0]);
+            return -1;
+        }
+        bool opened = stream.path.find_first_not_of("0123456789") == std::string::npos
+            ? stream.cap.open(atoi(stream.path.c_str()))
+            : stream.cap.open(stream.path);
+        if (!opened) {
+            std::cerr << "Could not open video" << stream.path << std::endl;
+            return -1;
+        }
+        stream.ring.resize(queueDepth);
+    }
+
+    // Blur-only deployments never load the person network.
+    bool person = false;
+    for (size_t i = 0; i < daemon.streams.size(); ++i) {
+        person = person || daemon.streams[i].mode != MODE_BLUR;
+    }
+
+    // Per-stream counters and queues are read from the daemon on each scrape;
+    // the server is declared after `daemon`, so it stops first.
+    for (size_t i = 0; i < daemon.streams.size(); ++i) {
+        Stream *stream = &daemon.streams[i];
+        std::string labels = format("stream=\"%zu\"", i);
+        callbackMetric(METRIC_COUNTER, "detector_frames_captured_total", "Frames decoded from the source",
+                       [stream] { return (double)stream->captured.load(); }, labels);
+        callbackMetric(METRIC_COUNTER, "detector_frames_processed_total", "Frames through detection",
+                       [stream] { return (double)stream->processed.load(); }, labels);
+        callbackMetric(METRIC_COUNTER, "detector_frames_dropped_total", "Frames dropped before they were processed",
+                       [stream] { return (double)stream->dropped.load(); }, labels);
+        callbackMetric(METRIC_GAUGE, "detector_queue_depth", "Frames waiting in a queue",
+                       [&daemon, stream]() -> double {
+                           std::lock_guard<std::mutex> guard(daemon.lock);
+                           return stream->count;
+                       }, labels);
+    }
+    callbackMetric(METRIC_GAUGE, "detector_workers_active", "Inference workers still running",
+                   [&daemon]() -> double {
+                       std::lock_guard<std::mutex> guard(daemon.lock);
+                       return daemon.activeWorkers;
+                   });
+    MetricsServer metrics(metricsPort);
+    if (metricsPort > 0 && !metrics.start()) return -1;
+
+    // Each worker's forwards use OpenCV's pool; split it between them.
+    cv::setNumThreads(std::max(1, cv::getNumThreads() / workers));
+
+    daemon.activeWorkers = workers;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < daemon.streams.size(); ++i) {
+        threads.push_back(std::thread(captureStream, std::ref(daemon), std::ref(daemon.streams[i]), maxFrames));
+        if (!headless) cv::namedWindow(format("Stream %zu", i), cv::WINDOW_NORMAL);
+    }
+    for (int i = 0; i < workers; ++i) {
+        threads.push_back(std::thread(inferenceWorker, std::ref(daemon), i, person, warmupRuns));
+    }
+
+    cv::Mat shown;
+    std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(daemon.lock);
+            if (daemon.activeWorkers == 0) break;
+        }
+
+        if (headless) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        } else {
+            for (size_t i = 0; i < daemon.streams.size(); ++i) {
+                Stream &stream = daemon.streams[i];
+                {
+                    std::lock_guard<std::mutex> guard(daemon.lock);
+                    if (!stream.fresh) continue;
+                    cv::swap(shown, stream.display);
+                    stream.fresh = false;
+                }
+                imshow(format("Stream %zu", i), shown);
+            }
+            if (waitKey(1) == 27) break; // stop if escape key is pressed
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastReport).count();
+        if (seconds >= 5.0) {
+            printRates(daemon, seconds);
+            lastReport = std::chrono::steady_clock::now();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(daemon.lock);
+        daemon.stopping = true;
+        daemon.work.notify_all();
+        daemon.space.notify_all();
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastReport).count();
+    printRates(daemon, std::max(seconds, 1e-3));
+    for (size_t i = 0; i < daemon.streams.size(); ++i) {
+        daemon.streams[i].cap.release();
+    }
+    if (!headless) destroyAllWindows();
+    return 0;
+}
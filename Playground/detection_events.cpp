@@ -0,0 +1,177 @@
+#include "detection_events.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Events formatted per write, and how long the writer sleeps when the ring
+// is empty.
+const size_t WRITE_BATCH = 512;
+const std::chrono::milliseconds IDLE_WAIT(5);
+
+// stdio buffer of the output file.
+const size_t FILE_BUFFER = 1 << 16;
+
+const char BINARY_MAGIC[8] = {'D', 'E', 'T', 'E', 'V', '1', 0, 0};
+const size_t BINARY_RECORD = 40;
+
+bool parseEventFormat(const std::string &name, EventFormat &format) {
+    if (name == "jsonl") format = EVENTS_JSONL;
+    else if (name == "binary") format = EVENTS_BINARY;
+    else return false;
+    return true;
+}
+
+int64_t eventTimestampUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// `,"class":"<name>"` with the name escaped for JSON, built once per class
+// so the writer only appends it.
+static std::string classField(const std::string &name) {
+    std::string field = ",\"class\":\"";
+    for (size_t i = 0; i < name.size(); ++i) {
+        unsigned char c = name[i];
+        if (c == '"' || c == '\\') {
+            field += '\\';
+            field += c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            field += escaped;
+        } else {
+            field += c;
+        }
+    }
+    return field + "\"";
+}
+
+static size_t roundUpPowerOfTwo(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+DetectionEventSink::DetectionEventSink(size_t capacity)
+    : ring(roundUpPowerOfTwo(std::max<size_t>(capacity, 2))), mask(ring.size() - 1), head(0), tail(0),
+      out(nullptr), ownsFile(false), outputFormat(EVENTS_JSONL), running(false), writtenCount(0), droppedCount(0) {}
+
+DetectionEventSink::~DetectionEventSink() {
+    close();
+}
+
+bool DetectionEventSink::open(const std::string &path, EventFormat format, const std::vector<std::string> &classNames) {
+    close();
+    if (path == "-") {
+        out = stdout;
+        ownsFile = false;
+    } else {
+        out = fopen(path.c_str(), format == EVENTS_BINARY ? "wb" : "w");
+        if (!out) return false;
+        ownsFile = true;
+    }
+    setvbuf(out, nullptr, _IOFBF, FILE_BUFFER);
+    if (format == EVENTS_BINARY) fwrite(BINARY_MAGIC, 1, sizeof(BINARY_MAGIC), out);
+
+    outputFormat = format;
+    classFields.clear();
+    for (size_t i = 0; i < classNames.size(); ++i) classFields.push_back(classField(classNames[i]));
+    running = true;
+    writer = std::thread(&DetectionEventSink::run, this);
+    return true;
+}
+
+bool DetectionEventSink::emit(const DetectionEvent &event) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == ring.size()) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ring[t & mask] = event;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+void DetectionEventSink::emitFrame(int64_t frame, const std::vector<cv::Rect> &boxes, const std::vector<int> &classIds,
+                                   const std::vector<float> &confidences, const std::vector<int> &indices) {
+    DetectionEvent event;
+    event.frame = frame;
+    event.timestampUs = eventTimestampUs();
+    for (size_t i = 0; i < indices.size(); ++i) {
+        int idx = indices[i];
+        event.classId = classIds[idx];
+        event.confidence = confidences[idx];
+        event.box = boxes[idx];
+        emit(event);
+    }
+}
+
+static void appendRecord(std::string &out, const DetectionEvent &event) {
+    char record[BINARY_RECORD];
+    int32_t fields[4] = {event.box.x, event.box.y, event.box.width, event.box.height};
+    // Little-endian hosts only, like the rest of the pipeline.
+    memcpy(record, &event.frame, 8);
+    memcpy(record + 8, &event.timestampUs, 8);
+    memcpy(record + 16, &event.classId, 4);
+    memcpy(record + 20, &event.confidence, 4);
+    memcpy(record + 24, fields, 16);
+    out.append(record, BINARY_RECORD);
+}
+
+void DetectionEventSink::appendEvent(const DetectionEvent &event, std::string &out) const {
+    if (outputFormat == EVENTS_BINARY) {
+        appendRecord(out, event);
+        return;
+    }
+
+    // Only numbers go through snprintf, so the line cannot be cut short
+    // however long a class name is; the name is appended from classFields.
+    char numbers[192];
+    int n = snprintf(numbers, sizeof(numbers), "{\"frame\":%lld,\"t_us\":%lld",
+                     (long long)event.frame, (long long)event.timestampUs);
+    out.append(numbers, n);
+    if (event.classId >= 0 && event.classId < (int)classFields.size()) out += classFields[event.classId];
+    n = snprintf(numbers, sizeof(numbers), ",\"class_id\":%d,\"confidence\":%.4f,\"box\":[%d,%d,%d,%d]}\n",
+                 event.classId, event.confidence, event.box.x, event.box.y, event.box.width, event.box.height);
+    out.append(numbers, n);
+}
+
+void DetectionEventSink::run() {
+    std::string buffer;
+    buffer.reserve(WRITE_BATCH * 128);
+
+    while (true) {
+        // Read `running` before the ring, so nothing queued before close()
+        // is left behind.
+        bool stopping = !running.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+
+        if (h == t) {
+            if (stopping) break;
+            fflush(out);
+            std::this_thread::sleep_for(IDLE_WAIT);
+            continue;
+        }
+
+        size_t end = std::min(t, h + WRITE_BATCH);
+        buffer.clear();
+        for (size_t i = h; i < end; ++i) appendEvent(ring[i & mask], buffer);
+        head.store(end, std::memory_order_release);
+
+        fwrite(buffer.data(), 1, buffer.size(), out);
+        writtenCount.fetch_add((long)(end - h), std::memory_order_relaxed);
+    }
+    fflush(out);
+}
+
+void DetectionEventSink::close() {
+    if (writer.joinable()) {
+        running = false;
+        writer.join();
+    }
+    if (out && ownsFile) fclose(out);
+    out = nullptr;
+    ownsFile = false;
+}
@@ -1,70 +1,269 @@
 // Code to detect and blur faces
 
 #include "utilities.h"
+#include "alloc_counter.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "resolution_controller.h"
+#include "skin_prefilter.h"
+#include "threaded_capture.h"
+#include "tracker.h"
 
 int main(int argc,char **argv) {
 
-    if(argc != 2){
-        std::cerr << "Usage: "<< argv[0] << " <video_file_path> "<<std::endl;
+    if(argc < 2){
+        std::cerr << "Usage: "<< argv[0] << " <video_file_path> [--track [--max-interval N]] [--anonymize gaussian|pixelate|box|fill] [--precision fp32|fp16|int8 [--calibration DIR]] [--fused-preprocess [--letterbox]] [--target-fps F | --latency-budget MS] [--every-frame | --latest-frame] [--skin-gate [--skin-min-area N] [--skin-max-skips N] [--skin-audit]] [--record out.mp4 [--segment-seconds N] [--record-policy drop|block]] [--models DIR] [--warmup-runs N] [--metrics-port N]"<<std::endl;
+        return -1;
     }
 
-    VideoCapture cap(argv[1]);
-    if(!cap.isOpened()) {
+    // Decoding runs on its own thread. Files default to every frame;
+    // cameras and streams to the latest frame; see threaded_capture.h.
+    CapturePolicy policy = isLiveSource(argv[1]) ? CAPTURE_LATEST_FRAME : CAPTURE_EVERY_FRAME;
+    if (hasFlag(argc, argv, "--every-frame")) policy = CAPTURE_EVERY_FRAME;
+    if (hasFlag(argc, argv, "--latest-frame")) policy = CAPTURE_LATEST_FRAME;
+    ThreadedCapture cap(argv[1], policy);
+    if(!cap.open()) {
         std::cerr <<"Could not open video"<<argv[1]<<std::endl;
         return -1;
     }
 
-    configNetwork(faceNet);
+    setModelDirectory(stringOption(argc, argv, "--models", "."));
+    if (!loadNetworks(false, true)) return -1;
+    if (!applyPrecisionOption(argc, argv, false, true)) return -1;
+    warmUpNetworks(intOption(argc, argv, "--warmup-runs", 1));
+
+    AnonymizeMethod anonymizer;
+    if (!parseAnonymizeMethod(stringOption(argc, argv, "--anonymize", "gaussian"), anonymizer)) {
+        std::cerr << "--anonymize must be gaussian, pixelate, box or fill" << std::endl;
+        return -1;
+    }
+    setFaceAnonymizer(anonymizer);
+
+    // Keyframe-only detection with tracked faces in between. The interval
+    // is kept short here since a face that walks in unseen stays unblurred
+    // until the next keyframe.
+    bool track = hasFlag(argc, argv, "--track");
+    KeyframeScheduler scheduler(intOption(argc, argv, "--max-interval", 4));
+    DetectionTracker tracker;
 
+    // Keyframes without face-like skin skip the face net; --skin-audit runs
+    // it anyway and counts the faces that would have stayed unblurred. See
+    // skin_prefilter.h. The prefilter can miss a face, so a skipped keyframe
+    // still blurs the previous frame's faces, moved by the tracker when
+    // tracking. Those faces go stale, so after --skin-max-skips rejected
+    // keyframes in a row the face net runs regardless of the prefilter.
+    bool skinGate = hasFlag(argc, argv, "--skin-gate");
+    bool skinAudit = hasFlag(argc, argv, "--skin-audit");
+    SkinPrefilter prefilter(intOption(argc, argv, "--skin-min-area", 40));
+    int maxSkinSkips = intOption(argc, argv, "--skin-max-skips", 3);
+    int skinSkips = 0;
+    DecodedBoxes lastFaces;
 
-    Mat frame, blob;
+    // With a frame-rate target or latency budget the network input size is
+    // chosen per frame between 320 and 608; see resolution_controller.h.
+    double targetFps = doubleOption(argc, argv, "--target-fps", 0.0);
+    double budgetMs = doubleOption(argc, argv, "--latency-budget", targetFps > 0 ? 1000.0 / targetFps : 0.0);
+    bool adaptive = budgetMs > 0;
+    ResolutionController resolution(budgetMs, NETWORK_WIDTH);
+    cv::Size inputSize(NETWORK_WIDTH, NETWORK_HEIGHT);
+
+    // preprocessFrame instead of blobFromImage; see preprocess.h. It reads
+    // the full-resolution capture, so the network input is resampled only
+    // once; the 1280x720 frame is still made for display and recording.
+    bool fusedPreprocess = hasFlag(argc, argv, "--fused-preprocess");
+    bool letterbox = hasFlag(argc, argv, "--letterbox");
+
+    // Buffers reused every frame; see frame_context.h.
+    FrameContext ctx;
+    Mat &capture = ctx.frame, &frame = ctx.resized, &blob = ctx.blob;
     double fps_factor = 1.0;
-    double video_fps = cap.get(cv::CAP_PROP_FPS);
-    fps_factor = 30.0/ video_fps;
+    double video_fps = cap.sourceFps();
+    if (video_fps > 0) fps_factor = 30.0/ video_fps;
     double fps = 0.0;
 
+    // Recording writes the anonymized frames on an encoder thread; see
+    // recorder.h. By default frames are dropped rather than slowing
+    // detection when the encoder falls behind.
+    std::string recordPath = stringOption(argc, argv, "--record", "");
+    RecordPolicy recordPolicy;
+    if (!parseRecordPolicy(stringOption(argc, argv, "--record-policy", "drop"), recordPolicy)) {
+        std::cerr << "--record-policy must be drop or block" << std::endl;
+        return -1;
+    }
+    double recordFps = video_fps > 0 ? video_fps : 30.0;
+    VideoRecorder recorder(recordPath, recordFps, (long)(intOption(argc, argv, "--segment-seconds", 0) * recordFps),
+                           recordPolicy);
+    if (!recordPath.empty()) recorder.start();
+
+    // Prometheus metrics on 127.0.0.1, e.g. --metrics-port 9100 and
+    // curl localhost:9100/metrics; see metrics.h. Network, detection and
+    // blur counts come from utilities.cpp.
+    int metricsPort = intOption(argc, argv, "--metrics-port", 0);
+    int framesProcessed = counterMetric("detector_frames_processed_total", "Frames through detection, tracking or reuse");
+    int captureWaitSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                             latencyBuckets(), "stage=\"capture_wait\"");
+    int detectSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                        latencyBuckets(), "stage=\"detect\"");
+    int trackSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                       latencyBuckets(), "stage=\"track\"");
+    int recordSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                        latencyBuckets(), "stage=\"record\"");
+    int frameSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                       latencyBuckets(), "stage=\"frame\"");
+    int inputSizeGauge = gaugeMetric("detector_input_size", "Network input width in pixels");
+    callbackMetric(METRIC_COUNTER, "detector_frames_captured_total", "Frames decoded from the source",
+                   [&cap] { return (double)cap.captured(); });
+    callbackMetric(METRIC_COUNTER, "detector_frames_dropped_total", "Frames dropped before they were processed",
+                   [&cap] { return (double)cap.dropped(); }, "queue=\"capture\"");
+    callbackMetric(METRIC_GAUGE, "detector_queue_depth", "Frames waiting in a queue",
+                   [&cap] { return (double)cap.queued(); }, "queue=\"capture\"");
+    if (!recordPath.empty()) {
+        callbackMetric(METRIC_COUNTER, "detector_frames_dropped_total", "Frames dropped before they were processed",
+                       [&recorder] { return (double)recorder.dropped(); }, "queue=\"recorder\"");
+        callbackMetric(METRIC_GAUGE, "detector_queue_depth", "Frames waiting in a queue",
+                       [&recorder] { return (double)recorder.queued(); }, "queue=\"recorder\"");
+    }
+    MetricsServer metrics(metricsPort);
+    if (metricsPort > 0 && !metrics.start()) return -1;
+
     cv::namedWindow("Detect", cv::WINDOW_NORMAL); 
     cv::resizeWindow("Detect", 1280, 720); 
 
     struct timespec start, end;
     double seconds;
     string label;
-    int frame_drop_limit = 100;
 
-    while(frame_drop_limit) {
-         if(!cap.read(frame)) {
-            frame_drop_limit--;
-            cerr<<"Frame Dropped, Limit pending: "<<frame_drop_limit<<endl;
-            continue;
-        }
+    // Debug builds (make COUNT_ALLOCATIONS=1) report frames that still
+    // allocate outside the DNN forward once warmed up; see alloc_counter.h.
+    AllocationCheck allocationCheck("faceblur", 100);
+    long long forwardAllocations;
+    installAllocationCounter();
 
-        cv::resize(frame,frame,cv::Size(1280,720));
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    while(cap.read(capture)) {
+        metricObserve(captureWaitSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count());
+        allocationCheck.beginFrame();
+        forwardAllocations = 0;
+        ctx.beginFrame();
+
+        cv::resize(capture,frame,cv::Size(1280,720));
         
         clock_gettime(CLOCK_MONOTONIC, &start);
 
-        vector<Mat> outs;
+        vector<Mat> &outs = ctx.faceOuts;
+
+        bool keyframe = true, forced = false;
+        if (track) {
+            cv::cvtColor(frame, ctx.gray, cv::COLOR_BGR2GRAY);
+            if (!scheduler.due()) {
+                keyframe = forced = !tracker.update(ctx.gray);
+            }
+        }
 
-        blobFromImage(frame, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+        bool skinTested = skinGate && keyframe;
+        bool runFaces = true;
+        if (skinTested) {
+            runFaces = prefilter.analyze(frame) || skinAudit || skinSkips >= maxSkinSkips;
+            skinSkips = runFaces ? 0 : skinSkips + 1;
+        }
 
-        detectFaces(blob, outs);        
-        
-        postProcess(frame, outs,true,false);
+        if (keyframe) {
+            if (!runFaces) {
+                // An unblurred face is a privacy leak, so a rejected frame
+                // is not taken as proof that there are none. The tracker
+                // restarts from these faces below.
+                if (track && !forced && tracker.update(ctx.gray)) lastFaces = tracker.faces();
+                ctx.faces = lastFaces;
+                drawDetections(frame, ctx.faces, true, false);
+            } else if (fusedPreprocess) {
+                Rect region = preprocessFrame(capture, inputSize, letterbox, ctx.preprocess, blob, frame.size());
+
+                forwardAllocations = threadAllocationCount();
+                detectFaces(blob, outs);
+                forwardAllocations = threadAllocationCount() - forwardAllocations;
+
+                getDetections(outs, region, true, ctx, ctx.faces);
+                drawDetections(frame, ctx.faces, true, false);
+            } else {
+                blobFromImage(frame, blob, 1/255.0, inputSize, Scalar(0, 0, 0), true, false);
+
+                forwardAllocations = threadAllocationCount();
+                detectFaces(blob, outs);
+                forwardAllocations = threadAllocationCount() - forwardAllocations;
+
+                postProcess(frame, outs,true,false,ctx);
+            }
+
+            if (track) {
+                tracker.reset(ctx.gray, ctx.people, ctx.faces);
+                scheduler.keyframe(forced);
+            }
+        } else {
+            // Tracked faces are blurred too; only the detection is skipped.
+            scheduler.tracked(tracker.confidence(), tracker.motion());
+            ctx.faces = tracker.faces();
+            drawDetections(frame, ctx.faces, true, false);
+        }
+
+        bool inferred = keyframe && runFaces;
+        if (inferred) reportFirstDetection();
+        if (skinGate) lastFaces = ctx.faces;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (inferred) metricObserve(detectSeconds, seconds);
+        else if (!keyframe) metricObserve(trackSeconds, seconds);
+
+        if (skinTested) {
+            if (skinAudit) prefilter.audit(ctx.faces.boxes);
+            if (prefilter.frameCount() % 100 == 0) cerr << prefilter.report() << endl;
+        }
+
+        if (track && scheduler.frames >= 100) {
+            double ratio = scheduler.takeKeyframeRatio();
+            cerr << format("Keyframes: %.0f%% of frames, interval %d", ratio * 100, scheduler.interval) << endl;
+        }
 
         clock_gettime(CLOCK_MONOTONIC, &end);
         seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
         fps = fps_factor / seconds;
 
+        // Only frames that ran the networks say anything about the input size.
+        if (adaptive && inferred) {
+            resolution.record(seconds * 1000.0);
+            inputSize = Size(resolution.size(), resolution.size());
+        }
+        metricObserve(frameSeconds, seconds);
+        metricAdd(framesProcessed);
+        metricSet(inputSizeGauge, inputSize.width);
+
+        // Every path above has blurred its faces by now. The recorder takes
+        // its copy before the FPS label is drawn.
+        if (!recordPath.empty()) {
+            ScopedMetricTimer timer(recordSeconds);
+            recorder.submit(frame);
+        }
+
+        allocationCheck.endFrame(forwardAllocations);
+
         // Display FPS on frame
-        label = format("FPS: %.2f", fps);
+        label = adaptive ? format("FPS: %.2f  Input: %d", fps, inputSize.width) : format("FPS: %.2f", fps);
         putText(frame, label, Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0), 2);
 
 
         imshow("Face Blur", frame);
         if (waitKey(1) == 27) break; // stop if escape key is pressed
-
+        waitStart = std::chrono::steady_clock::now();
     }
 
-    cap.release();
+    cap.stop();
+    cerr << format("Captured %ld frames, dropped %ld, late %ld, reconnects %ld",
+                   cap.captured(), cap.dropped(), cap.late(), cap.reconnects()) << endl;
+    if (!recordPath.empty()) {
+        recorder.stop();
+        cerr << format("Recorded %ld frames in %d files, dropped %ld",
+                       recorder.written(), recorder.segments(), recorder.dropped()) << endl;
+    }
     destroyAllWindows();
-    return 0;
+    return allocationCheck.report() ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef FORWARD_WORKER_H
+#define FORWARD_WORKER_H
+
+#include <opencv2/core.hpp>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs one network's forward passes on a thread that lives as long as the
+// worker, so two networks can run at the same time without a thread being
+// created per frame. start() hands over the blob and output vector; both
+// must stay untouched until wait() returns.
+//
+// Header-only so programs that do not link utilities.o (combined_dnn) can
+// use it too.
+class ForwardWorker {
+public:
+    typedef std::function<void(cv::Mat&, std::vector<cv::Mat>&)> Forward;
+
+    explicit ForwardWorker(const Forward &forward)
+        : forward(forward), blob(nullptr), outs(nullptr), pending(false), stopping(false),
+          thread(&ForwardWorker::run, this) {}
+
+    ~ForwardWorker() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+            ready.notify_one();
+        }
+        thread.join();
+    }
+
+    void start(cv::Mat &b, std::vector<cv::Mat> &o) {
+        std::lock_guard<std::mutex> guard(lock);
+        blob = &b;
+        outs = &o;
+        pending = true;
+        ready.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this] { return !pending; });
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            ready.wait(guard, [this] { return pending || stopping; });
+            if (stopping) break;
+            guard.unlock();
+            forward(*blob, *outs);
+            guard.lock();
+            pending = false;
+            done.notify_one();
+        }
+    }
+
+    Forward forward;
+    std::mutex lock;
+    std::condition_variable ready, done;
+    cv::Mat* blob;
+    std::vector<cv::Mat>* outs;
+    bool pending, stopping;
+    std::thread thread;
+};
+
+#endif
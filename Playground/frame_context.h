@@ -0,0 +1,71 @@
+#ifndef FRAME_CONTEXT_H
+#define FRAME_CONTEXT_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+#include "nms.h"
+#include "preprocess.h"
+#include "yolo_decoder.h"
+
+// Driver field-of-view trapezoid for one frame size. The mask and the
+// polygon's bounding rectangle only change with the resolution, so they
+// are built once and reused.
+struct FovMask {
+    cv::Size size;
+    cv::Point polygon[4];
+    cv::Mat mask;       // CV_8UC1, 255 inside the polygon
+    cv::Rect bounds;    // bounding rectangle of the polygon, inside the frame
+};
+
+// Buffers one stream needs for a frame, kept across frames so the steady
+// state loop reuses them instead of allocating. Mats are reused by
+// create()/read() when the size does not change; the box lists are
+// reserved up to the largest frame seen so far.
+struct FrameContext {
+    FrameContext() : candidateHighWater(0), keptHighWater(0) {}
+
+    cv::Mat frame;
+    cv::Mat resized;
+    cv::Mat gray;           // tracker input
+    cv::Mat maskedFrame;
+    FovMask fov;
+    cv::Mat blob;
+    PreprocessPlan preprocess;  // tables for preprocessFrame
+    std::vector<cv::Mat> personOuts;
+    std::vector<cv::Mat> faceOuts;
+
+    // Tiled mode: tile rectangles in frame coordinates, their views into
+    // the frame and one tile's rows of a batched output.
+    std::vector<cv::Rect> tiles;
+    std::vector<cv::Mat> tileCrops;
+    std::vector<cv::Mat> tileOuts;
+
+    DecodedBoxes candidates;    // decoded rows of one network, before NMS
+    DecodedBoxes people;        // kept person/cyclist detections
+    DecodedBoxes faces;         // kept face detections
+    std::vector<int> indices;
+    NmsScratch nms;
+
+    size_t candidateHighWater;
+    size_t keptHighWater;
+
+    void beginFrame() {
+        candidates.clear();
+        people.clear();
+        faces.clear();
+        indices.clear();
+        candidates.reserve(candidateHighWater);
+        people.reserve(keptHighWater);
+        faces.reserve(keptHighWater);
+        indices.reserve(candidateHighWater);
+    }
+
+    // Called after each decode so the next frame starts with enough room.
+    void noteHighWater() {
+        candidateHighWater = std::max(candidateHighWater, candidates.size());
+        keptHighWater = std::max(keptHighWater, std::max(people.size(), faces.size()));
+    }
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+double LatencyHistogram::percentile(double p) const {
+    if (samples.empty()) return 0.0;
+    std::vector<double> sorted(samples);
+    size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+double LatencyHistogram::max() const {
+    if (samples.empty()) return 0.0;
+    return *std::max_element(samples.begin(), samples.end());
+}
+
+double LatencyHistogram::mean() const {
+    if (samples.empty()) return 0.0;
+    return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+std::string LatencyHistogram::toJson() const {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+             "{\"stage\": \"%s\", \"count\": %zu, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+             "\"p90_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}",
+             name.c_str(), samples.size(), mean(), percentile(50), percentile(90), percentile(99), max());
+    return buffer;
+}
+
+double lapMs(std::chrono::steady_clock::time_point &start) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - start).count();
+    start = now;
+    return ms;
+}
@@ -0,0 +1,41 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Collects per-frame latency samples (milliseconds) for one stage and
+// summarizes them as percentiles.
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(const std::string &name = "") : name(name) {}
+
+    void add(double ms) { samples.push_back(ms); }
+
+    void reserve(size_t n) { samples.reserve(n); }
+
+    void clear() { samples.clear(); }
+
+    size_t count() const { return samples.size(); }
+
+    const std::string &getName() const { return name; }
+
+    double percentile(double p) const;
+
+    double max() const;
+
+    double mean() const;
+
+    std::string toJson() const;
+
+private:
+    std::string name;
+    std::vector<double> samples;
+};
+
+// Milliseconds since `start`; resets `start` to now so consecutive stages
+// can be timed with a single time point.
+double lapMs(std::chrono::steady_clock::time_point &start);
+
+#endif
@@ -0,0 +1,350 @@
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+const int MAX_METRICS = 128;
+const int MAX_METRIC_CELLS = 1024;     // 8 KB per updating thread
+
+struct MetricInfo {
+    MetricInfo() : type(METRIC_COUNTER), cell(0) {}
+
+    MetricType type;
+    std::string name, help, labels;
+    std::vector<double> bounds;         // histograms
+    int cell;                           // first cell in every shard
+    std::function<double()> read;       // callback metrics
+};
+
+// One thread's cells. Only that thread writes them; scrapes only read.
+struct MetricShard {
+    MetricShard() {
+        for (int i = 0; i < MAX_METRIC_CELLS; ++i) cells[i].store(0, std::memory_order_relaxed);
+        for (int i = 0; i < MAX_METRICS; ++i) sums[i].store(0.0, std::memory_order_relaxed);
+    }
+
+    std::atomic<unsigned long long> cells[MAX_METRIC_CELLS];   // counter values, histogram buckets
+    std::atomic<double> sums[MAX_METRICS];                      // histogram sums, by metric id
+};
+
+struct Registry {
+    Registry() : count(0), cells(0) {
+        for (int i = 0; i < MAX_METRICS; ++i) gauges[i].store(0.0, std::memory_order_relaxed);
+    }
+
+    std::mutex lock;
+    MetricInfo metrics[MAX_METRICS];    // entries below `count` never change
+    int count, cells;
+    std::vector<MetricShard*> shards;   // never freed, so exited threads still count
+    std::atomic<double> gauges[MAX_METRICS];
+};
+
+// Never destroyed: metrics may be updated from static initializers and
+// from threads that outlive main().
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+MetricShard& localShard() {
+    static thread_local MetricShard* shard = nullptr;
+    if (!shard) {
+        shard = new MetricShard();
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> guard(reg.lock);
+        reg.shards.push_back(shard);
+    }
+    return *shard;
+}
+
+// Single writer per cell, so a plain load and store is enough.
+inline void bump(std::atomic<unsigned long long> &cell, unsigned long long n) {
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+int registerMetric(MetricType type, const std::string &name, const std::string &help, const std::string &labels,
+                   const std::vector<double> &bounds, const std::function<double()> &read) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (int i = 0; i < reg.count; ++i) {
+        if (reg.metrics[i].name == name && reg.metrics[i].labels == labels) return i;
+    }
+
+    int cells = type == METRIC_HISTOGRAM ? (int)bounds.size() + 1 : type == METRIC_COUNTER && !read ? 1 : 0;
+    if (reg.count == MAX_METRICS || reg.cells + cells > MAX_METRIC_CELLS) {
+        std::cerr << "Metric registry full; not exporting " << name << std::endl;
+        return -1;
+    }
+
+    MetricInfo &info = reg.metrics[reg.count];
+    info.type = type;
+    info.name = name;
+    info.help = help;
+    info.labels = labels;
+    info.bounds = bounds;
+    info.cell = reg.cells;
+    info.read = read;
+    reg.cells += cells;
+    return reg.count++;
+}
+
+const char* typeName(MetricType type) {
+    switch (type) {
+        case METRIC_GAUGE: return "gauge";
+        case METRIC_HISTOGRAM: return "histogram";
+        default: return "counter";
+    }
+}
+
+std::string formatValue(double value) {
+    if (std::isinf(value)) return value > 0 ? "+Inf" : "-Inf";
+    if (std::isnan(value)) return "NaN";
+    char text[32];
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        snprintf(text, sizeof(text), "%.0f", value);
+    } else {
+        snprintf(text, sizeof(text), "%.9g", value);
+    }
+    return text;
+}
+
+// name{labels,extra}, leaving out the braces when there are no labels.
+std::string series(const std::string &name, const std::string &labels, const std::string &extra = "") {
+    std::string all = labels.empty() ? extra : extra.empty() ? labels : labels + "," + extra;
+    return all.empty() ? name : name + "{" + all + "}";
+}
+
+unsigned long long sumCell(const std::vector<MetricShard*> &shards, int cell) {
+    unsigned long long total = 0;
+    for (size_t i = 0; i < shards.size(); ++i) total += shards[i]->cells[cell].load(std::memory_order_relaxed);
+    return total;
+}
+
+void appendMetric(const MetricInfo &info, int id, const std::vector<MetricShard*> &shards, std::string &out) {
+    if (info.read) {
+        out += series(info.name, info.labels) + " " + formatValue(info.read()) + "\n";
+    } else if (info.type == METRIC_COUNTER) {
+        out += series(info.name, info.labels) + " " + formatValue((double)sumCell(shards, info.cell)) + "\n";
+    } else if (info.type == METRIC_GAUGE) {
+        out += series(info.name, info.labels) + " " +
+               formatValue(registry().gauges[id].load(std::memory_order_relaxed)) + "\n";
+    } else {
+        // Prometheus buckets are cumulative; ours are not.
+        unsigned long long cumulative = 0;
+        for (size_t b = 0; b <= info.bounds.size(); ++b) {
+            cumulative += sumCell(shards, info.cell + (int)b);
+            double bound = b < info.bounds.size() ? info.bounds[b] : INFINITY;
+            out += series(info.name + "_bucket", info.labels, "le=\"" + formatValue(bound) + "\"") + " " +
+                   formatValue((double)cumulative) + "\n";
+        }
+        double sum = 0.0;
+        for (size_t i = 0; i < shards.size(); ++i) sum += shards[i]->sums[id].load(std::memory_order_relaxed);
+        out += series(info.name + "_sum", info.labels) + " " + formatValue(sum) + "\n";
+        out += series(info.name + "_count", info.labels) + " " + formatValue((double)cumulative) + "\n";
+    }
+}
+
+long long steadyNanos() {
+    return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+int counterMetric(const std::string &name, const std::string &help, const std::string &labels) {
+    return registerMetric(METRIC_COUNTER, name, help, labels, std::vector<double>(), std::function<double()>());
+}
+
+int gaugeMetric(const std::string &name, const std::string &help, const std::string &labels) {
+    return registerMetric(METRIC_GAUGE, name, help, labels, std::vector<double>(), std::function<double()>());
+}
+
+int histogramMetric(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+                    const std::string &labels) {
+    return registerMetric(METRIC_HISTOGRAM, name, help, labels, bounds, std::function<double()>());
+}
+
+void callbackMetric(MetricType type, const std::string &name, const std::string &help,
+                    const std::function<double()> &read, const std::string &labels) {
+    // A histogram cannot be read from a single value.
+    if (type == METRIC_HISTOGRAM || !read) return;
+    registerMetric(type, name, help, labels, std::vector<double>(), read);
+}
+
+void metricAdd(int id, long n) {
+    if (id < 0) return;
+    bump(localShard().cells[registry().metrics[id].cell], (unsigned long long)n);
+}
+
+void metricSet(int id, double value) {
+    if (id < 0) return;
+    registry().gauges[id].store(value, std::memory_order_relaxed);
+}
+
+void metricObserve(int id, double value) {
+    if (id < 0) return;
+    const MetricInfo &info = registry().metrics[id];
+    size_t bucket = 0;
+    while (bucket < info.bounds.size() && value > info.bounds[bucket]) ++bucket;
+
+    MetricShard &shard = localShard();
+    bump(shard.cells[info.cell + bucket], 1);
+    shard.sums[id].store(shard.sums[id].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+std::vector<double> latencyBuckets() {
+    static const double bounds[] = {0.001, 0.0025, 0.005, 0.01, 0.02, 0.033, 0.05, 0.075, 0.1, 0.15, 0.25, 0.5,
+                                    1.0, 2.5};
+    return std::vector<double>(bounds, bounds + sizeof(bounds) / sizeof(bounds[0]));
+}
+
+ScopedMetricTimer::ScopedMetricTimer(int id) : id(id), start(steadyNanos()) {}
+
+ScopedMetricTimer::~ScopedMetricTimer() {
+    metricObserve(id, (steadyNanos() - start) / 1e9);
+}
+
+std::string renderMetrics() {
+    // Copied under the lock, then read without it: callbacks may take locks
+    // of their own, held elsewhere by threads that are about to register.
+    std::vector<MetricInfo> metrics;
+    std::vector<MetricShard*> shards;
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> guard(reg.lock);
+        metrics.assign(reg.metrics, reg.metrics + reg.count);
+        shards = reg.shards;
+    }
+
+    // Families are written together, in the order they were first registered.
+    std::string out;
+    std::vector<bool> written(metrics.size(), false);
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        if (written[i]) continue;
+        const MetricInfo &family = metrics[i];
+        out += "# HELP " + family.name + " " + family.help + "\n";
+        out += "# TYPE " + family.name + " " + typeName(family.type) + "\n";
+        for (size_t j = i; j < metrics.size(); ++j) {
+            if (written[j] || metrics[j].name != family.name) continue;
+            appendMetric(metrics[j], (int)j, shards, out);
+            written[j] = true;
+        }
+    }
+    return out;
+}
+
+MetricsServer::MetricsServer(int port) : listenPort(port), listener(-1), stopping(false), scrapeCount(0) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start() {
+    if (thread.joinable()) return true;
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Could not create the metrics socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)listenPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 8) < 0) {
+        std::cerr << "Could not serve metrics on 127.0.0.1:" << listenPort << ": " << strerror(errno) << std::endl;
+        close(listener);
+        listener = -1;
+        return false;
+    }
+
+    stopping = false;
+    thread = std::thread(&MetricsServer::run, this);
+    std::cerr << "Serving metrics on http://127.0.0.1:" << listenPort << "/metrics" << std::endl;
+    return true;
+}
+
+void MetricsServer::stop() {
+    stopping = true;
+    if (thread.joinable()) thread.join();
+    if (listener >= 0) {
+        close(listener);
+        listener = -1;
+    }
+}
+
+void MetricsServer::run() {
+    while (!stopping.load()) {
+        // Polls with a timeout so stop() is noticed without a connection.
+        pollfd fd;
+        fd.fd = listener;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        if (poll(&fd, 1, 200) <= 0) continue;
+
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) continue;
+        serve(client);
+        close(client);
+    }
+}
+
+// One request per connection; scrapers open a new one each time anyway.
+void MetricsServer::serve(int client) {
+    // A client that stalls must not hold up the next scrape for long.
+    timeval timeout;
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Only the request line matters; read up to the end of the headers.
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos &&
+           request.size() < 8192) {
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        request.append(buffer, (size_t)n);
+    }
+    std::string line = request.substr(0, request.find_first_of("\r\n"));
+    std::string target = line.compare(0, 4, "GET ") == 0 ? line.substr(4, line.find(' ', 4) - 4) : "";
+    target = target.substr(0, target.find('?'));
+
+    std::string status = "200 OK", type = "text/plain; version=0.0.4; charset=utf-8", body;
+    if (target == "/metrics") {
+        body = renderMetrics();
+        scrapeCount++;
+    } else {
+        status = "404 Not Found";
+        type = "text/plain; charset=utf-8";
+        body = "Metrics are served at /metrics\n";
+    }
+
+    std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+                           "\r\nContent-Length: " + std::to_string(body.size()) +
+                           "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += (size_t)n;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Process-wide counters, gauges and histograms, served in the Prometheus
+// text format by MetricsServer.
+//
+// Every thread that updates a metric gets its own block of cells on first
+// use. Updates are a relaxed load and store on the caller's own cell: no
+// lock, no atomic read-modify-write and no cache line shared with other
+// threads. A scrape sums the cells of every thread, including threads that
+// have since exited.
+//
+// Register metrics once, at startup or from a static initializer, and keep
+// the returned id; registering the same name and labels again returns the
+// same id. Metrics sharing a name but not labels form one family, e.g.
+// counterMetric("detector_detections_total", "...", "class=\"face\"").
+// An id of -1 (the registry is full) is accepted and ignored everywhere.
+enum MetricType {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+};
+
+int counterMetric(const std::string &name, const std::string &help, const std::string &labels = "");
+int gaugeMetric(const std::string &name, const std::string &help, const std::string &labels = "");
+// `bounds` are the upper bucket limits in increasing order; +Inf is implied.
+int histogramMetric(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+                    const std::string &labels = "");
+
+// A counter or gauge whose value is read by calling `read` on each scrape,
+// for values something else already keeps, such as queue lengths. `read`
+// runs on the server thread, so it has to be thread-safe, and whatever it
+// refers to has to outlive the server.
+void callbackMetric(MetricType type, const std::string &name, const std::string &help,
+                    const std::function<double()> &read, const std::string &labels = "");
+
+void metricAdd(int id, long n = 1);         // counters
+void metricSet(int id, double value);       // gauges; the last write wins
+void metricObserve(int id, double value);   // histograms
+
+// Upper bounds for latencies in seconds, 1 ms to 2.5 s.
+std::vector<double> latencyBuckets();
+
+// Observes the seconds between construction and destruction.
+class ScopedMetricTimer {
+public:
+    explicit ScopedMetricTimer(int id);
+    ~ScopedMetricTimer();
+
+private:
+    int id;
+    long long start;
+};
+
+// All metrics in the Prometheus text exposition format (version 0.0.4).
+std::string renderMetrics();
+
+// Answers GET /metrics on 127.0.0.1:port from a background thread; any
+// other path gets a 404. Only reachable from the local machine.
+class MetricsServer {
+public:
+    explicit MetricsServer(int port);
+    ~MetricsServer();
+
+    // Binds and starts the thread; false, with the reason on stderr, if the
+    // port cannot be bound.
+    bool start();
+    void stop();
+
+    int port() const { return listenPort; }
+    long scrapes() const { return scrapeCount.load(); }
+
+private:
+    void run();
+    void serve(int client);
+
+    int listenPort;
+    int listener;
+    std::atomic<bool> stopping;
+    std::thread thread;
+    std::atomic<long> scrapeCount;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "motion_gate.h"
+
+#include <opencv2/imgproc.hpp>
+
+// Working resolution of the comparison; large enough for a pedestrian far
+// down the street to change a few dozen pixels.
+const cv::Size GATE_SIZE(160, 120);
+
+bool MotionGate::shouldRun(const cv::Mat &frame) {
+    ++frames;
+
+    cv::resize(frame, small, GATE_SIZE, 0, 0, cv::INTER_AREA);
+    if (small.channels() == 3) {
+        cv::cvtColor(small, thumb, cv::COLOR_BGR2GRAY);
+    } else {
+        small.copyTo(thumb);
+    }
+    // Smooths sensor noise so it does not count as motion at night.
+    cv::GaussianBlur(thumb, thumb, cv::Size(5, 5), 0);
+
+    bool run = reference.empty() || ++sinceRun >= refreshInterval;
+    if (!run) {
+        cv::absdiff(thumb, reference, diff);
+        cv::threshold(diff, diff, pixelThreshold, 255, cv::THRESH_BINARY);
+        run = cv::countNonZero(diff) > minChangedFraction * diff.total();
+    }
+
+    if (run) {
+        cv::swap(thumb, reference);
+        sinceRun = 0;
+    } else {
+        ++skipped;
+    }
+    return run;
+}
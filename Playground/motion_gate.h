@@ -0,0 +1,38 @@
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <opencv2/core.hpp>
+
+// Decides whether a frame from a static camera needs inference at all. The
+// frame is shrunk to a small gray thumbnail and compared with the thumbnail
+// of the last frame that was run; only when enough pixels changed (or the
+// refresh interval ran out) does it return true. The test is made on the
+// current frame, so a person stepping in is detected on the first frame
+// that shows them.
+class MotionGate {
+public:
+    explicit MotionGate(int refreshInterval = 30, double minChangedFraction = 0.002, int pixelThreshold = 25)
+        : refreshInterval(refreshInterval), minChangedFraction(minChangedFraction), pixelThreshold(pixelThreshold),
+          sinceRun(0), frames(0), skipped(0) {}
+
+    // True when the networks should run on `frame`; the frame then becomes
+    // the new reference.
+    bool shouldRun(const cv::Mat &frame);
+
+    long frameCount() const { return frames; }
+
+    // Fraction of all frames seen so far that were skipped.
+    double skippedFraction() const { return frames > 0 ? (double)skipped / frames : 0.0; }
+
+private:
+    int refreshInterval;
+    double minChangedFraction;
+    int pixelThreshold;
+
+    cv::Mat small, thumb, reference, diff;
+    int sinceRun;
+    long frames;
+    long skipped;
+};
+
+#endif
@@ -0,0 +1,337 @@
+#include "nms.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// Below this many boxes a frame is suppressed on the calling thread; the
+// parallel_for_ dispatch costs more than it saves.
+const size_t PARALLEL_MIN_BOXES = 512;
+
+// Uniform grid over the extent of the candidate boxes. Cells are sized to
+// the mean box so a box typically lands in a handful of cells.
+class BoxGrid {
+public:
+    BoxGrid(const std::vector<cv::Rect> &boxes, const std::vector<int> &candidates, std::vector<std::vector<int> > &cells)
+        : cells(cells) {
+        int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+        double sumSize = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            const cv::Rect &box = boxes[candidates[i]];
+            minX = std::min(minX, box.x);
+            minY = std::min(minY, box.y);
+            maxX = std::max(maxX, box.x + box.width);
+            maxY = std::max(maxY, box.y + box.height);
+            sumSize += std::max(box.width, box.height);
+        }
+        if (candidates.empty()) {
+            minX = minY = maxX = maxY = 0;
+        }
+
+        originX = minX;
+        originY = minY;
+        cellSize = std::max(8, (int)(sumSize / std::max<size_t>(1, candidates.size())));
+        // Keep the grid bounded when a few boxes are far apart.
+        while ((long long)((maxX - minX) / cellSize + 1) * ((maxY - minY) / cellSize + 1) > MAX_CELLS) {
+            cellSize *= 2;
+        }
+        cols = (maxX - minX) / cellSize + 1;
+        rows = (maxY - minY) / cellSize + 1;
+
+        // Grow only, so the cell lists keep their capacity between frames.
+        size_t used = (size_t)cols * rows;
+        if (cells.size() < used) cells.resize(used);
+        for (size_t i = 0; i < used; ++i) {
+            cells[i].clear();
+        }
+    }
+
+    // Cells covered by the pixels of `box`; false for empty boxes.
+    bool range(const cv::Rect &box, int &c0, int &c1, int &r0, int &r1) const {
+        if (box.width <= 0 || box.height <= 0) return false;
+        c0 = clampCol((box.x - originX) / cellSize);
+        c1 = clampCol((box.x + box.width - 1 - originX) / cellSize);
+        r0 = clampRow((box.y - originY) / cellSize);
+        r1 = clampRow((box.y + box.height - 1 - originY) / cellSize);
+        return true;
+    }
+
+    std::vector<int> &cell(int c, int r) { return cells[(size_t)r * cols + c]; }
+
+private:
+    static const long long MAX_CELLS = 1 << 16;
+
+    int clampCol(int c) const { return std::min(std::max(c, 0), cols - 1); }
+    int clampRow(int r) const { return std::min(std::max(r, 0), rows - 1); }
+
+    std::vector<std::vector<int> > &cells;
+    int originX, originY, cellSize, cols, rows;
+};
+
+// Same overlap measure and rounding as NMSBoxes.
+inline float rectOverlap(const cv::Rect &a, const cv::Rect &b) {
+    return 1.f - static_cast<float>(cv::jaccardDistance(a, b));
+}
+
+// Highest score first, ties by index: the order the stable sort in
+// NMSBoxes produces, without the stable sort's temporary buffer.
+inline bool scoreThenIndex(const std::pair<float, int> &a, const std::pair<float, int> &b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+void sortCandidates(const std::vector<float> &scores, const std::vector<int> &subset, float scoreThreshold,
+                    NmsWorkspace &ws) {
+    ws.ranked.clear();
+    for (size_t i = 0; i < subset.size(); ++i) {
+        if (scores[subset[i]] > scoreThreshold)
+            ws.ranked.push_back(std::make_pair(scores[subset[i]], subset[i]));
+    }
+    std::sort(ws.ranked.begin(), ws.ranked.end(), scoreThenIndex);
+    ws.order.resize(ws.ranked.size());
+    for (size_t i = 0; i < ws.ranked.size(); ++i) {
+        ws.order[i] = ws.ranked[i].second;
+    }
+}
+
+void hardNMS(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores, const std::vector<int> &subset,
+             const NmsParams &params, NmsWorkspace &ws) {
+    sortCandidates(scores, subset, params.scoreThreshold, ws);
+
+    BoxGrid grid(boxes, ws.order, ws.cells);
+    // Last candidate each kept box was compared with, so a kept box spanning
+    // several shared cells is only tested once.
+    ws.stamp.assign(boxes.size(), -1);
+    // Two empty boxes have overlap 1 in NMSBoxes even when far apart.
+    bool keptEmpty = false;
+    int c0, c1, r0, r1;
+
+    for (size_t n = 0; n < ws.order.size(); ++n) {
+        int idx = ws.order[n];
+        const cv::Rect &box = boxes[idx];
+        bool keep = true;
+
+        if (!grid.range(box, c0, c1, r0, r1)) {
+            keep = !(keptEmpty && 1.f > params.nmsThreshold);
+            if (keep) {
+                keptEmpty = true;
+                ws.kept.push_back(idx);
+                ws.keptScores.push_back(scores[idx]);
+            }
+            continue;
+        }
+
+        for (int r = r0; r <= r1 && keep; ++r) {
+            for (int c = c0; c <= c1 && keep; ++c) {
+                const std::vector<int> &cell = grid.cell(c, r);
+                for (size_t k = 0; k < cell.size(); ++k) {
+                    int other = cell[k];
+                    if (ws.stamp[other] == idx) continue;
+                    ws.stamp[other] = idx;
+                    if (rectOverlap(box, boxes[other]) > params.nmsThreshold) {
+                        keep = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (keep) {
+            ws.kept.push_back(idx);
+            ws.keptScores.push_back(scores[idx]);
+            for (int r = r0; r <= r1; ++r) {
+                for (int c = c0; c <= c1; ++c) {
+                    grid.cell(c, r).push_back(idx);
+                }
+            }
+        }
+    }
+}
+
+// Gaussian soft-NMS: instead of discarding an overlapping box its score is
+// multiplied by exp(-IoU^2 / sigma); boxes drop out once below the score
+// threshold. All candidates are binned up front so only intersecting boxes
+// are decayed.
+void softNMS(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores, const std::vector<int> &subset,
+             const NmsParams &params, NmsWorkspace &ws) {
+    sortCandidates(scores, subset, params.scoreThreshold, ws);
+
+    BoxGrid grid(boxes, ws.order, ws.cells);
+    ws.current.assign(boxes.size(), 0.f);
+    ws.done.assign(boxes.size(), 0);
+    ws.stamp.assign(boxes.size(), -1);
+    ws.heap.clear();
+    int c0, c1, r0, r1;
+
+    for (size_t n = 0; n < ws.order.size(); ++n) {
+        int idx = ws.order[n];
+        ws.current[idx] = scores[idx];
+        // Negative index keeps the lower index first among equal scores.
+        ws.heap.push_back(std::make_pair(scores[idx], -idx));
+        if (grid.range(boxes[idx], c0, c1, r0, r1)) {
+            for (int r = r0; r <= r1; ++r)
+                for (int c = c0; c <= c1; ++c)
+                    grid.cell(c, r).push_back(idx);
+        }
+    }
+    std::make_heap(ws.heap.begin(), ws.heap.end());
+
+    while (!ws.heap.empty()) {
+        std::pop_heap(ws.heap.begin(), ws.heap.end());
+        std::pair<float, int> top = ws.heap.back();
+        ws.heap.pop_back();
+        int idx = -top.second;
+        // Stale entry left behind by an earlier decay.
+        if (ws.done[idx] || top.first != ws.current[idx]) continue;
+        if (top.first <= params.scoreThreshold) break;
+
+        ws.done[idx] = 1;
+        ws.kept.push_back(idx);
+        ws.keptScores.push_back(top.first);
+
+        if (!grid.range(boxes[idx], c0, c1, r0, r1)) continue;
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                const std::vector<int> &cell = grid.cell(c, r);
+                for (size_t k = 0; k < cell.size(); ++k) {
+                    int other = cell[k];
+                    if (ws.done[other] || ws.stamp[other] == idx) continue;
+                    ws.stamp[other] = idx;
+                    float iou = rectOverlap(boxes[idx], boxes[other]);
+                    if (iou <= 0.f) continue;
+                    ws.current[other] *= std::exp(-(iou * iou) / params.sigma);
+                    ws.heap.push_back(std::make_pair(ws.current[other], -other));
+                    std::push_heap(ws.heap.begin(), ws.heap.end());
+                }
+            }
+        }
+    }
+}
+
+void suppress(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores, const NmsParams &params,
+              NmsWorkspace &ws) {
+    ws.kept.clear();
+    ws.keptScores.clear();
+    if (params.mode == NMS_SOFT_GAUSSIAN)
+        softNMS(boxes, scores, ws.members, params, ws);
+    else
+        hardNMS(boxes, scores, ws.members, params, ws);
+}
+
+class ClassNMSBody : public cv::ParallelLoopBody {
+public:
+    ClassNMSBody(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores, const NmsParams &params,
+                 std::vector<NmsWorkspace> &perClass)
+        : boxes(boxes), scores(scores), params(params), perClass(perClass) {}
+
+    void operator()(const cv::Range &range) const {
+        for (int c = range.start; c < range.end; ++c) {
+            suppress(boxes, scores, params, perClass[c]);
+        }
+    }
+
+private:
+    const std::vector<cv::Rect> &boxes;
+    const std::vector<float> &scores;
+    const NmsParams &params;
+    std::vector<NmsWorkspace> &perClass;
+};
+
+}
+
+void fastNMSBoxes(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores, float scoreThreshold,
+                  float nmsThreshold, std::vector<int> &indices) {
+    CV_Assert(boxes.size() == scores.size());
+    NmsWorkspace ws;
+    ws.members.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        ws.members[i] = (int)i;
+    }
+    suppress(boxes, scores, NmsParams(scoreThreshold, nmsThreshold), ws);
+    indices.swap(ws.kept);
+}
+
+void classAwareNMS(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores, const std::vector<int> &classIds,
+                   const NmsParams &params, std::vector<int> &indices, std::vector<float> *keptScores) {
+    NmsScratch scratch;
+    classAwareNMS(boxes, scores, classIds, params, scratch, indices, keptScores);
+}
+
+void classAwareNMS(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores, const std::vector<int> &classIds,
+                   const NmsParams &params, NmsScratch &scratch, std::vector<int> &indices, std::vector<float> *keptScores) {
+    CV_Assert(boxes.size() == scores.size() && boxes.size() == classIds.size());
+
+    // Group by class id; ids are small (person, cyclist) but not assumed dense.
+    std::vector<int> &classes = scratch.classes;
+    classes.assign(classIds.begin(), classIds.end());
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+
+    if (scratch.perClass.size() < classes.size()) scratch.perClass.resize(classes.size());
+    for (size_t c = 0; c < classes.size(); ++c) {
+        scratch.perClass[c].members.clear();
+    }
+    for (size_t i = 0; i < classIds.size(); ++i) {
+        size_t c = std::lower_bound(classes.begin(), classes.end(), classIds[i]) - classes.begin();
+        scratch.perClass[c].members.push_back((int)i);
+    }
+
+    ClassNMSBody body(boxes, scores, params, scratch.perClass);
+    if (classes.size() > 1 && boxes.size() >= PARALLEL_MIN_BOXES)
+        cv::parallel_for_(cv::Range(0, (int)classes.size()), body);
+    else
+        body(cv::Range(0, (int)classes.size()));
+
+    // Merge by score, then index, matching the order NMSBoxes produces.
+    std::vector<std::pair<float, int> > &merged = scratch.merged;
+    merged.clear();
+    for (size_t c = 0; c < classes.size(); ++c) {
+        const NmsWorkspace &ws = scratch.perClass[c];
+        for (size_t k = 0; k < ws.kept.size(); ++k) {
+            merged.push_back(std::make_pair(ws.keptScores[k], ws.kept[k]));
+        }
+    }
+    std::sort(merged.begin(), merged.end(), scoreThenIndex);
+
+    indices.resize(merged.size());
+    if (keptScores) keptScores->resize(merged.size());
+    for (size_t i = 0; i < merged.size(); ++i) {
+        indices[i] = merged[i].second;
+        if (keptScores) (*keptScores)[i] = merged[i].first;
+    }
+}
+
+namespace {
+
+class StreamNMSBody : public cv::ParallelLoopBody {
+public:
+    StreamNMSBody(const std::vector<std::vector<cv::Rect> > &boxes, const std::vector<std::vector<float> > &scores,
+                  const std::vector<std::vector<int> > &classIds, const NmsParams &params,
+                  std::vector<std::vector<int> > &indices)
+        : boxes(boxes), scores(scores), classIds(classIds), params(params), indices(indices) {}
+
+    void operator()(const cv::Range &range) const {
+        for (int s = range.start; s < range.end; ++s) {
+            classAwareNMS(boxes[s], scores[s], classIds[s], params, indices[s]);
+        }
+    }
+
+private:
+    const std::vector<std::vector<cv::Rect> > &boxes;
+    const std::vector<std::vector<float> > &scores;
+    const std::vector<std::vector<int> > &classIds;
+    const NmsParams &params;
+    std::vector<std::vector<int> > &indices;
+};
+
+}
+
+void batchedClassAwareNMS(const std::vector<std::vector<cv::Rect> > &boxes, const std::vector<std::vector<float> > &scores,
+                          const std::vector<std::vector<int> > &classIds, const NmsParams &params,
+                          std::vector<std::vector<int> > &indices) {
+    CV_Assert(boxes.size() == scores.size() && boxes.size() == classIds.size());
+    indices.resize(boxes.size());
+    cv::parallel_for_(cv::Range(0, (int)boxes.size()), StreamNMSBody(boxes, scores, classIds, params, indices));
+}
@@ -0,0 +1,70 @@
+#ifndef NMS_H
+#define NMS_H
+
+#include <opencv2/core.hpp>
+#include <utility>
+#include <vector>
+
+// Non-maximum suppression with spatial binning: kept boxes are filed into a
+// uniform grid and a candidate is only compared against kept boxes that
+// share a cell with it, since boxes that do not intersect have IoU 0.
+//
+// In hard mode the result is exactly what cv::dnn::NMSBoxes returns for the
+// same list (same indices, same order). Soft mode applies Gaussian
+// soft-NMS and returns the decayed scores as well.
+
+enum NmsMode {
+    NMS_HARD,
+    NMS_SOFT_GAUSSIAN
+};
+
+struct NmsParams {
+    NmsParams(float scoreThreshold, float nmsThreshold)
+        : scoreThreshold(scoreThreshold), nmsThreshold(nmsThreshold), mode(NMS_HARD), sigma(0.5f) {}
+
+    float scoreThreshold;
+    float nmsThreshold;
+    NmsMode mode;
+    float sigma;
+};
+
+// Reusable buffers for suppressing one class.
+struct NmsWorkspace {
+    std::vector<std::pair<float, int> > ranked;
+    std::vector<int> order;
+    std::vector<int> stamp;
+    std::vector<std::vector<int> > cells;
+    std::vector<float> current;
+    std::vector<char> done;
+    std::vector<std::pair<float, int> > heap;
+    std::vector<int> members;
+    std::vector<int> kept;
+    std::vector<float> keptScores;
+};
+
+// Buffers classAwareNMS keeps between calls. Hold one per stream and
+// suppression stops allocating once the buffers have grown to the
+// busiest frame seen so far.
+struct NmsScratch {
+    std::vector<int> classes;
+    std::vector<NmsWorkspace> perClass;
+    std::vector<std::pair<float, int> > merged;
+};
+
+// Class-agnostic suppression over the whole list; drop-in for NMSBoxes.
+void fastNMSBoxes(const std::vector<cv::Rect>&, const std::vector<float>&, float, float, std::vector<int>&);
+
+// Suppresses each class separately (classes run in parallel), so a person
+// never suppresses an overlapping cyclist. Indices are ordered by score
+// like NMSBoxes. `keptScores` receives the soft-NMS scores when non-null.
+void classAwareNMS(const std::vector<cv::Rect>&, const std::vector<float>&, const std::vector<int>&,
+                   const NmsParams&, std::vector<int>&, std::vector<float>* keptScores = nullptr);
+
+void classAwareNMS(const std::vector<cv::Rect>&, const std::vector<float>&, const std::vector<int>&,
+                   const NmsParams&, NmsScratch&, std::vector<int>&, std::vector<float>* keptScores = nullptr);
+
+// Independent lists, e.g. one per camera, suppressed in parallel.
+void batchedClassAwareNMS(const std::vector<std::vector<cv::Rect> >&, const std::vector<std::vector<float> >&,
+                          const std::vector<std::vector<int> >&, const NmsParams&, std::vector<std::vector<int> >&);
+
+#endif
@@ -0,0 +1,64 @@
+// Scaling benchmark for the binned NMS engine against cv::dnn::NMSBoxes,
+// with an equality check of the returned indices at every size.
+
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <chrono>
+#include <cstdio>
+#include "nms.h"
+
+const float SCORE_THRESHOLD = 0.3f;
+const float IOU_THRESHOLD = 0.3f;
+
+// Pedestrian-like boxes in clusters over a 1080p frame, as in a crowded crossing.
+void makeBoxes(int n, cv::RNG &rng, std::vector<cv::Rect> &boxes, std::vector<float> &scores, std::vector<int> &classIds) {
+    boxes.clear();
+    scores.clear();
+    classIds.clear();
+    int clusters = std::max(1, n / 20);
+    std::vector<cv::Point> centers;
+    for (int i = 0; i < clusters; ++i) {
+        centers.push_back(cv::Point(rng.uniform(0, 1920), rng.uniform(0, 1080)));
+    }
+    for (int i = 0; i < n; ++i) {
+        cv::Point c = centers[rng.uniform(0, clusters)];
+        int w = rng.uniform(20, 80), h = rng.uniform(40, 200);
+        boxes.push_back(cv::Rect(c.x + rng.uniform(-30, 30) - w / 2, c.y + rng.uniform(-30, 30) - h / 2, w, h));
+        scores.push_back(rng.uniform(0.f, 1.f));
+        classIds.push_back(rng.uniform(0, 2));
+    }
+}
+
+template <typename F>
+double timeMs(F f, int repeats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+int main() {
+    const int sizes[] = {10, 100, 1000, 3000, 10000};
+    cv::RNG rng(12345);
+    std::vector<cv::Rect> boxes;
+    std::vector<float> scores;
+    std::vector<int> classIds, reference, fast, perClass;
+    bool allMatch = true;
+
+    printf("%8s %14s %14s %14s %8s\n", "boxes", "NMSBoxes ms", "fastNMS ms", "per-class ms", "match");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int n = sizes[s];
+        int repeats = std::max(1, 20000 / n);
+        makeBoxes(n, rng, boxes, scores, classIds);
+
+        double refMs = timeMs([&]() { cv::dnn::NMSBoxes(boxes, scores, SCORE_THRESHOLD, IOU_THRESHOLD, reference); }, repeats);
+        double fastMs = timeMs([&]() { fastNMSBoxes(boxes, scores, SCORE_THRESHOLD, IOU_THRESHOLD, fast); }, repeats);
+        double classMs = timeMs([&]() {
+            classAwareNMS(boxes, scores, classIds, NmsParams(SCORE_THRESHOLD, IOU_THRESHOLD), perClass);
+        }, repeats);
+
+        bool match = reference == fast;
+        allMatch = allMatch && match;
+        printf("%8d %14.4f %14.4f %14.4f %8s\n", n, refMs, fastMs, classMs, match ? "yes" : "NO");
+    }
+    return allMatch ? 0 : 1;
+}
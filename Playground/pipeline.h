@@ -0,0 +1,106 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bounded single-producer / single-consumer ring buffer used between two
+// pipeline stages. One slot is always left free so that head == tail means
+// empty; no locks are taken on either side.
+template <typename T>
+class SPSCQueue {
+public:
+    explicit SPSCQueue(size_t depth)
+        : slots(depth + 1), head(0), tail(0), closed(false) {}
+
+    bool tryPush(T &item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) % slots.size();
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+        slots[t] = std::move(item);
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = std::move(slots[h]);
+        head.store((h + 1) % slots.size(), std::memory_order_release);
+        return true;
+    }
+
+    // Waits for a free slot. Returns false if the queue was closed meanwhile.
+    bool push(T &item) {
+        int spins = 0;
+        while (!tryPush(item)) {
+            if (closed.load(std::memory_order_acquire))
+                return false;
+            backoff(spins);
+        }
+        return true;
+    }
+
+    // Waits for an item. Returns false once the queue is closed and drained.
+    bool pop(T &item) {
+        int spins = 0;
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire))
+                return tryPop(item);
+            backoff(spins);
+        }
+        return true;
+    }
+
+    void close() { closed.store(true, std::memory_order_release); }
+
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+    size_t size() const {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        return (t + slots.size() - h) % slots.size();
+    }
+
+    size_t capacity() const { return slots.size() - 1; }
+
+private:
+    // Spin briefly, then yield, then sleep so an idle stage does not burn a core.
+    static void backoff(int &spins) {
+        ++spins;
+        if (spins < 64)
+            return;
+        if (spins < 256)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    std::vector<T> slots;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<bool> closed;
+};
+
+// Busy-time accounting for one stage thread; read from the display thread.
+struct StageStats {
+    StageStats() : busyNs(0), frames(0) {}
+
+    void record(std::chrono::steady_clock::time_point start) {
+        busyNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start).count(),
+                         std::memory_order_relaxed);
+        frames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<long long> busyNs;
+    std::atomic<long long> frames;
+};
+
+#endif
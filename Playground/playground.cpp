@@ -1,25 +1,100 @@
 #include "utilities.h"
+#include "resolution_controller.h"
+#include "threaded_capture.h"
+#include "alloc_counter.h"
+#include "metrics.h"
+#include "motion_gate.h"
+#include "skin_prefilter.h"
+#include "tracker.h"
 
 
 int main(int argc, char** argv) {
 
-    if(argc != 2){
-        std::cerr << "Usage: "<< argv[0] << " <video_file_path> "<<std::endl;
+    if(argc < 2){
+        std::cerr << "Usage: "<< argv[0] << " <video_file_path> [--cascade] [--track [--max-interval N]] [--motion-gate [--refresh N]] [--tiles [--tile-cols N] [--tile-rows N] [--tile-overlap PCT]] [--anonymize gaussian|pixelate|box|fill] [--precision fp32|fp16|int8 [--calibration DIR]] [--fused-preprocess [--letterbox]] [--target-fps F | --latency-budget MS] [--every-frame | --latest-frame] [--skin-gate [--skin-min-area N] [--skin-max-skips N] [--skin-audit]] [--models DIR] [--warmup-runs N] [--metrics-port N]"<<std::endl;
+        return -1;
     }
     
-    VideoCapture cap(argv[1]);
-    if(!cap.isOpened()) {
+    // Decoding runs on its own thread. Files default to every frame;
+    // cameras and streams to the latest frame; see threaded_capture.h.
+    CapturePolicy policy = isLiveSource(argv[1]) ? CAPTURE_LATEST_FRAME : CAPTURE_EVERY_FRAME;
+    if (hasFlag(argc, argv, "--every-frame")) policy = CAPTURE_EVERY_FRAME;
+    if (hasFlag(argc, argv, "--latest-frame")) policy = CAPTURE_LATEST_FRAME;
+    ThreadedCapture cap(argv[1], policy);
+    if(!cap.open()) {
         std::cerr <<"Could not open video"<<argv[1]<<std::endl;
         return -1;
     }
 
-    configNetwork(personNet);
-    // configNetwork(faceNet);
+    setModelDirectory(stringOption(argc, argv, "--models", "."));
+    if (!loadNetworks(true, true)) return -1;
+    if (!applyPrecisionOption(argc, argv, true, true)) return -1;
+    warmUpNetworks(intOption(argc, argv, "--warmup-runs", 1));
+
+    AnonymizeMethod anonymizer;
+    if (!parseAnonymizeMethod(stringOption(argc, argv, "--anonymize", "gaussian"), anonymizer)) {
+        std::cerr << "--anonymize must be gaussian, pixelate, box or fill" << std::endl;
+        return -1;
+    }
+    setFaceAnonymizer(anonymizer);
+
+    // Cascade mode runs the face net only on head crops of detected people.
+    bool cascade = hasFlag(argc, argv, "--cascade");
+
+    // Tiled mode keeps the full capture resolution and runs the networks on
+    // a batch of overlapping tiles, so distant people stay large enough to
+    // detect. Counts of 0 pick enough network-sized tiles to cover the frame.
+    // Takes precedence over --cascade.
+    bool tiled = hasFlag(argc, argv, "--tiles");
+    int tileCols = intOption(argc, argv, "--tile-cols", 0);
+    int tileRows = intOption(argc, argv, "--tile-rows", 0);
+    float tileOverlap = intOption(argc, argv, "--tile-overlap", 20) / 100.f;
+    cv::Size tiledSize;
+
+    // Track mode runs the networks on keyframes only and moves the boxes
+    // with optical flow in between; see tracker.h.
+    bool track = hasFlag(argc, argv, "--track");
+    KeyframeScheduler scheduler(intOption(argc, argv, "--max-interval", 8));
+    DetectionTracker tracker;
 
-    cv::Mat frame, blob;
+    // For static cameras: frames that barely differ from the last one that
+    // was run skip inference and reuse its detections; see motion_gate.h.
+    bool gate = hasFlag(argc, argv, "--motion-gate");
+    MotionGate motionGate(intOption(argc, argv, "--refresh", 30));
+    DecodedBoxes lastPeople, lastFaces;
+
+    // Untiled, non-cascade keyframes without face-like skin skip the face
+    // forward; --skin-audit runs it anyway and counts what would have been
+    // missed. See skin_prefilter.h. At most --skin-max-skips keyframes in a
+    // row skip it.
+    bool skinGate = hasFlag(argc, argv, "--skin-gate");
+    bool skinAudit = hasFlag(argc, argv, "--skin-audit");
+    SkinPrefilter prefilter(intOption(argc, argv, "--skin-min-area", 40));
+    int maxSkinSkips = intOption(argc, argv, "--skin-max-skips", 3);
+    int skinSkips = 0;
+
+    // With a frame-rate target or latency budget the network input size is
+    // chosen per frame between 320 and 608; see resolution_controller.h.
+    double targetFps = doubleOption(argc, argv, "--target-fps", 0.0);
+    double budgetMs = doubleOption(argc, argv, "--latency-budget", targetFps > 0 ? 1000.0 / targetFps : 0.0);
+    bool adaptive = budgetMs > 0 && !tiled;    // tiles always match the network size
+    ResolutionController resolution(budgetMs, NETWORK_WIDTH);
+    cv::Size inputSize(NETWORK_WIDTH, NETWORK_HEIGHT);
+
+    // Builds the untiled network input with preprocessFrame instead of
+    // blobFromImage, optionally letterboxed; see preprocess.h. It reads the
+    // full-resolution capture, so the network input is resampled only once;
+    // the 640x480 frame is still made for display, tracking and the gates.
+    bool fusedPreprocess = hasFlag(argc, argv, "--fused-preprocess");
+    bool letterbox = hasFlag(argc, argv, "--letterbox");
+    Rect region;
+
+    // Buffers reused every frame; see frame_context.h.
+    FrameContext ctx;
+    cv::Mat &capture = ctx.frame, &frame = ctx.resized, &blob = ctx.blob;
     double fps_factor = 1.0;
-    double video_fps = cap.get(cv::CAP_PROP_FPS);
-    fps_factor = 30.0/ video_fps;
+    double video_fps = cap.sourceFps();
+    if (video_fps > 0) fps_factor = 30.0/ video_fps;
     double fps = 0.0;
 
     cv::namedWindow("Detect", cv::WINDOW_NORMAL); 
@@ -28,43 +103,230 @@ int main(int argc, char** argv) {
     struct timespec start, end;
     double seconds;
     string label;
-    int frame_drop_limit = 100;
+    // Debug builds (make COUNT_ALLOCATIONS=1) report frames that still
+    // allocate outside the DNN forward once warmed up; see alloc_counter.h.
+    AllocationCheck allocationCheck("playground", 100);
+    long long forwardAllocations;
+    installAllocationCounter();
 
+    // Prometheus metrics on 127.0.0.1, e.g. --metrics-port 9100 and
+    // curl localhost:9100/metrics; see metrics.h. Network, detection and
+    // blur counts come from utilities.cpp.
+    int metricsPort = intOption(argc, argv, "--metrics-port", 0);
+    int framesProcessed = counterMetric("detector_frames_processed_total", "Frames through detection, tracking or reuse");
+    int captureWaitSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                             latencyBuckets(), "stage=\"capture_wait\"");
+    int detectSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                        latencyBuckets(), "stage=\"detect\"");
+    int trackSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                       latencyBuckets(), "stage=\"track\"");
+    int frameSeconds = histogramMetric("detector_stage_seconds", "Wall time per pipeline stage",
+                                       latencyBuckets(), "stage=\"frame\"");
+    int inputSizeGauge = gaugeMetric("detector_input_size", "Network input width in pixels");
+    callbackMetric(METRIC_COUNTER, "detector_frames_captured_total", "Frames decoded from the source",
+                   [&cap] { return (double)cap.captured(); });
+    callbackMetric(METRIC_COUNTER, "detector_frames_dropped_total", "Frames dropped before they were processed",
+                   [&cap] { return (double)cap.dropped(); }, "queue=\"capture\"");
+    callbackMetric(METRIC_GAUGE, "detector_queue_depth", "Frames waiting in a queue",
+                   [&cap] { return (double)cap.queued(); }, "queue=\"capture\"");
+    MetricsServer metrics(metricsPort);
+    if (metricsPort > 0 && !metrics.start()) return -1;
 
-    while (frame_drop_limit) {
-        if(!cap.read(frame)) {
-            frame_drop_limit--;
-            cerr<<"Frame Dropped, Limit pending: "<<frame_drop_limit<<endl;
-            continue;
-        }
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+
+    while (cap.read(capture)) {
+        metricObserve(captureWaitSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count());
+        allocationCheck.beginFrame();
+        forwardAllocations = 0;
+        ctx.beginFrame();
 
-        cv::resize(frame,frame,cv::Size(640,480),0,0,cv::INTER_LINEAR);
+        if (tiled) {
+            // Same-size buffers, so swapping never makes read() reallocate.
+            cv::swap(capture, frame);
+        } else {
+            cv::resize(capture,frame,cv::Size(640,480),0,0,cv::INTER_LINEAR);
+        }
         
         clock_gettime(CLOCK_MONOTONIC, &start);
-        vector<Mat> outs;
+        vector<Mat> &personOuts = ctx.personOuts, &faceOuts = ctx.faceOuts;
+
+        bool keyframe = true, forced = false;
+        bool still = gate && !motionGate.shouldRun(frame);
+        if (track && !still) {
+            cv::cvtColor(frame, ctx.gray, cv::COLOR_BGR2GRAY);
+            if (!scheduler.due()) {
+                keyframe = forced = !tracker.update(ctx.gray);
+            }
+        }
+
+        bool skinTested = skinGate && keyframe && !still && !tiled && !cascade;
+        bool runFaces = true;
+        if (skinTested) {
+            runFaces = prefilter.analyze(frame) || skinAudit || skinSkips >= maxSkinSkips;
+            skinSkips = runFaces ? 0 : skinSkips + 1;
+        }
+        if (!runFaces) {
+            // The prefilter can miss a face, so the last faces, moved by
+            // the tracker when tracking, stay blurred on a rejected keyframe
+            // and the tracker restarts from them below.
+            if (track && !forced && tracker.update(ctx.gray)) lastFaces = tracker.faces();
+            ctx.faces = lastFaces;
+        }
+
+        if (still) {
+            ctx.people = lastPeople;
+            ctx.faces = lastFaces;
+
+            drawDetections(frame, ctx.people, false, false);
+
+            drawDetections(frame, ctx.faces, true, false);
+        } else if (!keyframe) {
+            scheduler.tracked(tracker.confidence(), tracker.motion());
+
+            ctx.people = tracker.people();
+            ctx.faces = tracker.faces();
+
+            drawDetections(frame, ctx.people, false, false);
+
+            drawDetections(frame, ctx.faces, true, false);
+        } else if (tiled) {
+            if (frame.size() != tiledSize) {
+                tileFrame(frame.size(), tileCols, tileRows, tileOverlap, ctx.tiles);
+                tiledSize = frame.size();
+            }
+            ctx.tileCrops.resize(ctx.tiles.size());
+            for (size_t i = 0; i < ctx.tiles.size(); ++i) ctx.tileCrops[i] = frame(ctx.tiles[i]);
+
+            blobFromImages(ctx.tileCrops, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+
+            forwardAllocations = threadAllocationCount();
+            detectPeopleAndFaces(blob, personOuts, faceOuts);
+            forwardAllocations = threadAllocationCount() - forwardAllocations;
 
-        blobFromImage(frame, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+            getTiledDetections(personOuts, ctx.tiles, false, ctx, ctx.people);
+            getTiledDetections(faceOuts, ctx.tiles, true, ctx, ctx.faces);
 
-        detectPeople(blob,outs);
+            drawDetections(frame, ctx.people, false, false);
 
-        postProcess(frame, outs,false,false);
+            drawDetections(frame, ctx.faces, true, false);
+        } else if (cascade) {
+            region = Rect(0, 0, frame.cols, frame.rows);
+            if (fusedPreprocess) {
+                region = preprocessFrame(capture, inputSize, letterbox, ctx.preprocess, blob, frame.size());
+            } else {
+                blobFromImage(frame, blob, 1/255.0, inputSize, Scalar(0, 0, 0), true, false);
+            }
 
-        detectFaces(blob, outs);
+            forwardAllocations = threadAllocationCount();
+            detectPeople(blob, personOuts);
+            forwardAllocations = threadAllocationCount() - forwardAllocations;
 
-        postProcess(frame,outs,true,false);
+            getDetections(personOuts, region, false, ctx, ctx.people);
+
+            // One forward per person; the crops are counted with the forwards.
+            long long cascadeAllocations = threadAllocationCount();
+            detectFacesInPeople(capture, frame, ctx.people.boxes, ctx.faces.boxes, ctx.faces.confidences);
+            forwardAllocations += threadAllocationCount() - cascadeAllocations;
+            ctx.faces.classIds.assign(ctx.faces.size(), 0);
+
+            drawDetections(frame, ctx.people, false, false);
+
+            drawDetections(frame, ctx.faces, true, false);
+        } else if (fusedPreprocess) {
+            region = preprocessFrame(capture, inputSize, letterbox, ctx.preprocess, blob, frame.size());
+
+            forwardAllocations = threadAllocationCount();
+            if (runFaces) {
+                detectPeopleAndFaces(blob, personOuts, faceOuts);
+            } else {
+                detectPeople(blob, personOuts);
+            }
+            forwardAllocations = threadAllocationCount() - forwardAllocations;
+
+            // With a letterbox the input covers more than the frame.
+            getDetections(personOuts, region, false, ctx, ctx.people);
+            if (runFaces) getDetections(faceOuts, region, true, ctx, ctx.faces);
+
+            drawDetections(frame, ctx.people, false, false);
+
+            drawDetections(frame, ctx.faces, true, false);
+        } else {
+            blobFromImage(frame, blob, 1/255.0, inputSize, Scalar(0, 0, 0), true, false);
+
+            forwardAllocations = threadAllocationCount();
+            if (runFaces) {
+                detectPeopleAndFaces(blob, personOuts, faceOuts);
+            } else {
+                detectPeople(blob, personOuts);
+            }
+            forwardAllocations = threadAllocationCount() - forwardAllocations;
+
+            postProcess(frame, personOuts,false,false,ctx);
+
+            if (runFaces) {
+                postProcess(frame,faceOuts,true,false,ctx);
+            } else {
+                drawDetections(frame, ctx.faces, true, false);
+            }
+        }
+
+        bool inferred = keyframe && !still;
+        if (inferred) reportFirstDetection();
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (inferred) metricObserve(detectSeconds, seconds);
+        else if (!still) metricObserve(trackSeconds, seconds);
+
+        // The tracker restarts from this frame's detections; `gray` was
+        // taken before anything was drawn on the frame.
+        if (track && inferred) {
+            tracker.reset(ctx.gray, ctx.people, ctx.faces);
+            scheduler.keyframe(forced);
+        }
+        if (gate && !still) lastPeople = ctx.people;
+        if ((gate || skinGate) && !still) lastFaces = ctx.faces;
+
+        if (track && scheduler.frames >= 100) {
+            double ratio = scheduler.takeKeyframeRatio();
+            cerr << format("Keyframes: %.0f%% of frames, interval %d", ratio * 100, scheduler.interval) << endl;
+        }
+
+        if (skinTested) {
+            if (skinAudit) prefilter.audit(ctx.faces.boxes);
+            if (prefilter.frameCount() % 100 == 0) cerr << prefilter.report() << endl;
+        }
+
+        if (gate && motionGate.frameCount() % 100 == 0) {
+            cerr << format("Motion gate skipped %.1f%% of frames", motionGate.skippedFraction() * 100) << endl;
+        }
+
+        allocationCheck.endFrame(forwardAllocations);
 
         clock_gettime(CLOCK_MONOTONIC, &end);
         seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
         fps = fps_factor / seconds;
 
+        // Only frames that ran the networks say anything about the input size.
+        if (adaptive && inferred) {
+            resolution.record(seconds * 1000.0);
+            inputSize = Size(resolution.size(), resolution.size());
+        }
+        metricObserve(frameSeconds, seconds);
+        metricAdd(framesProcessed);
+        metricSet(inputSizeGauge, tiled ? NETWORK_WIDTH : inputSize.width);
+
         // Display FPS on frame
-        label = format("FPS: %.2f", fps);
+        label = adaptive ? format("FPS: %.2f  Input: %d", fps, inputSize.width) : format("FPS: %.2f", fps);
         putText(frame, label, Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0), 2);
 
         imshow("Detect", frame);
         if (waitKey(1) == 27) break; // stop if escape key is pressed
+        waitStart = std::chrono::steady_clock::now();
     }
-    cap.release();
+    cap.stop();
+    cerr << format("Captured %ld frames, dropped %ld, late %ld, reconnects %ld",
+                   cap.captured(), cap.dropped(), cap.late(), cap.reconnects()) << endl;
     destroyAllWindows();
-    return 0;
+    return allocationCheck.report() ? 0 : 1;
 }   
\ No newline at end of file
@@ -1,45 +1,123 @@
 #include "utilities.h"
+#include "alloc_counter.h"
+#include "pipeline.h"
 
 
 using namespace std;
 
-void maskFrame(Mat& frame, Mat& maskedFrame){
-    int frameWidth = frame.cols;
-    int frameHeight = frame.rows;
+// Everything one frame needs on its way through the pipeline.
+struct FramePacket {
+    long id;
+    cv::Mat frame;
+    cv::Mat blob;
+    cv::Rect region;    // part of the frame the blob was made from
+    std::vector<cv::Mat> personOuts;
+    std::vector<cv::Mat> faceOuts;
+};
 
-    // Calculate points for the field of view
-    cv::Point leftcenter(frameWidth / 4, frameHeight);
-    cv::Point rightcenter(3 * frameWidth / 4 , frameHeight);
-    cv::Point leftPoint(frameWidth / 10 , frameHeight / 2);
-    cv::Point rightPoint(9 * frameWidth / 10, frameHeight / 2);
+typedef SPSCQueue<FramePacket> FrameQueue;
 
-    // Draw lines to represent the field of view
-    cv::line(frame, leftcenter, leftPoint, cv::Scalar(0, 255, 0), 2, cv::LINE_AA);
-    cv::line(frame, rightcenter, rightPoint, cv::Scalar(0, 255, 0), 2, cv::LINE_AA);
-    cv::line(frame, leftPoint, rightPoint, cv::Scalar(0, 255, 0), 2, cv::LINE_AA);
+void usage(const char* name) {
+    std::cerr << "Usage: " << name << " <video_file_path> [--queue-depth N] [--stats] [--roi-crop] [--models DIR] [--warmup-runs N]" << std::endl;
+}
+
+// Forward outputs can alias the net's internal buffers, which the next
+// forward() overwrites while this frame is still queued downstream.
+void detachOutputs(std::vector<cv::Mat>& outs) {
+    for (size_t i = 0; i < outs.size(); ++i) {
+        outs[i] = outs[i].clone();
+    }
+}
+
+void captureStage(VideoCapture& cap, FrameQueue& out, StageStats& stats, std::atomic<bool>& stop) {
+    int frame_drop_limit = 100;
+    long id = 0;
+    FramePacket packet;
 
-    std::vector<cv::Point> polygon;
-    polygon.push_back(leftcenter);
-    polygon.push_back(rightcenter);
-    polygon.push_back(rightPoint);
-    polygon.push_back(leftPoint);
+    while (frame_drop_limit && !stop.load()) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(!cap.read(packet.frame)) {
+            frame_drop_limit--;
+            cerr<<"Frame Dropped, Limit pending: "<<frame_drop_limit<<endl;
+            continue;
+        }
+        packet.id = id++;
+        stats.record(start);
+        if (!out.push(packet)) break;
+    }
+    out.close();
+}
 
-    // Create a mask with the same dimensions as the frame, initially all 0 (black)
-    cv::Mat mask = cv::Mat::zeros(frame.size(), frame.type());
+// With roiCrop the network only sees the bounding rectangle of the field of
+// view, so its input is spent on the road instead of the blacked-out sky.
+void preprocessStage(FrameQueue& in, FrameQueue& out, StageStats& stats, bool roiCrop) {
+    FramePacket packet;
+    Mat maskedFrame;
+    FovMask fov;
+
+    while (in.pop(packet)) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        maskFrame(packet.frame, maskedFrame, fov);
+        packet.region = roiCrop ? fov.bounds : Rect(0, 0, packet.frame.cols, packet.frame.rows);
+        blobFromImage(maskedFrame(packet.region), packet.blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+        stats.record(start);
+        if (!out.push(packet)) break;
+    }
+    out.close();
+}
 
-    // Fill the polygon with white color in the mask
-    cv::fillConvexPoly(mask, polygon.data(), polygon.size(), cv::Scalar(255, 255, 255));
+void inferenceStage(FrameQueue& in, FrameQueue& out, StageStats& stats) {
+    FramePacket packet;
 
-    // Apply the mask to the frame
-    frame.copyTo(maskedFrame, mask);
+    while (in.pop(packet)) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        detectPeopleAndFaces(packet.blob, packet.personOuts, packet.faceOuts);
+        detachOutputs(packet.personOuts);
+        detachOutputs(packet.faceOuts);
+        stats.record(start);
+        if (!out.push(packet)) break;
+    }
+    out.close();
 }
 
+// Only this stage is checked for steady-state allocations: the others
+// allocate per frame by design (detachOutputs clones every output).
+void postprocessStage(FrameQueue& in, FrameQueue& out, StageStats& stats, AllocationCheck& allocationCheck) {
+    FramePacket packet;
+    FrameContext ctx;
+
+    while (in.pop(packet)) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        allocationCheck.beginFrame();
+        ctx.beginFrame();
+        // Boxes come back in full-frame coordinates even when the blob was cropped.
+        getDetections(packet.personOuts, packet.region, false, ctx, ctx.people);
+        drawDetections(packet.frame, ctx.people, false, true);
+        getDetections(packet.faceOuts, packet.region, true, ctx, ctx.faces);
+        drawDetections(packet.frame, ctx.faces, true, false);
+        allocationCheck.endFrame();
+        stats.record(start);
+        if (!out.push(packet)) break;
+    }
+    out.close();
+}
 
+// Average output-queue fill and busy time per stage. A stage whose output
+// queue stays full is waiting on the stage after it; the busiest stage with
+// a near-empty output queue is the bottleneck.
+void printOccupancy(const char* names[], StageStats* stats[], double occupancy[], size_t capacity, int samples, double wallSeconds) {
+    std::cerr << "Pipeline over " << samples << " frames:" << std::endl;
+    for (int i = 0; i < 4; ++i) {
+        fprintf(stderr, "  %-12s out queue %.2f/%zu  busy %5.1f%%\n", names[i], occupancy[i] / samples, capacity,
+                100.0 * stats[i]->busyNs.load() / 1e9 / wallSeconds);
+    }
+}
 
 int main(int argc, char** argv) {
 
-    if(argc != 2){
-        std::cerr << "Usage: "<< argv[0] << " <video_file_path> "<<std::endl;
+    if(argc < 2){
+        usage(argv[0]);
+        return -1;
     }
     
     VideoCapture cap(argv[1]);
@@ -47,59 +125,86 @@ int main(int argc, char** argv) {
         std::cerr <<"Could not open video"<<argv[1]<<std::endl;
         return -1;
     }
+
+    int queue_depth = intOption(argc, argv, "--queue-depth", 2);
+    bool show_stats = hasFlag(argc, argv, "--stats");
+    bool roi_crop = hasFlag(argc, argv, "--roi-crop");
+    if (queue_depth < 1) {
+        usage(argv[0]);
+        return -1;
+    }
    
-    configNetwork(personNet);
-    configNetwork(faceNet);
+    setModelDirectory(stringOption(argc, argv, "--models", "."));
+    if (!loadNetworks(true, true)) return -1;
+    warmUpNetworks(intOption(argc, argv, "--warmup-runs", 1));
 
-    Mat frame, maskedFrame,blob;
-    double fps_factor = 1.0;
-    double video_fps = cap.get(cv::CAP_PROP_FPS);
-    fps_factor = 30.0/ video_fps;
     double fps = 0.0;
 
     cv::namedWindow("Detect", cv::WINDOW_NORMAL); 
     cv::resizeWindow("Detect", 1280, 720); 
 
-    struct timespec start, end;
+    struct timespec start, end, statsStart;
     double seconds;
     string label;
-    int frame_drop_limit = 100;
-
 
-    while (frame_drop_limit) {
-        if(!cap.read(frame)) {
-            frame_drop_limit--;
-            cerr<<"Frame Dropped, Limit pending: "<<frame_drop_limit<<endl;
-            continue;
+    FrameQueue captured(queue_depth), preprocessed(queue_depth), inferred(queue_depth), finished(queue_depth);
+    FrameQueue* queues[] = {&captured, &preprocessed, &inferred, &finished};
+    StageStats captureStats, preprocessStats, inferenceStats, postprocessStats;
+    StageStats* stats[] = {&captureStats, &preprocessStats, &inferenceStats, &postprocessStats};
+    const char* names[] = {"capture", "preprocess", "inference", "postprocess"};
+    double occupancy[4] = {0, 0, 0, 0};
+    int samples = 0;
+    std::atomic<bool> stop(false);
+
+    // Debug builds (make COUNT_ALLOCATIONS=1); see alloc_counter.h.
+    AllocationCheck allocationCheck("playground_driver postprocess", 100);
+    installAllocationCounter();
+
+    std::thread captureThread(captureStage, std::ref(cap), std::ref(captured), std::ref(captureStats), std::ref(stop));
+    std::thread preprocessThread(preprocessStage, std::ref(captured), std::ref(preprocessed), std::ref(preprocessStats), roi_crop);
+    std::thread inferenceThread(inferenceStage, std::ref(preprocessed), std::ref(inferred), std::ref(inferenceStats));
+    std::thread postprocessThread(postprocessStage, std::ref(inferred), std::ref(finished), std::ref(postprocessStats),
+                                  std::ref(allocationCheck));
+
+    FramePacket packet;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    statsStart = start;
+
+    while (finished.pop(packet)) {
+        reportFirstDetection();
+        for (int i = 0; i < 4; ++i) {
+            occupancy[i] += queues[i]->size();
         }
-
-        clock_gettime(CLOCK_MONOTONIC, &start);
-        vector<Mat> outs;
-
-        maskFrame(frame,maskedFrame);
-
-        blobFromImage(maskedFrame, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
-        
-        detectPeople(blob,outs);
-
-        postProcess(frame, outs,false,true);
-
-        detectFaces(blob, outs);
-
-        postProcess(frame,outs,true,false);
+        ++samples;
 
         clock_gettime(CLOCK_MONOTONIC, &end);
         seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
-        fps = fps_factor / seconds;
+        start = end;
+        fps = 1.0 / seconds;
 
         // Display FPS on frame
         label = format("FPS: %.2f", fps);
-        putText(frame, label, Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0), 2);
+        putText(packet.frame, label, Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0), 2);
+
+        if (show_stats && samples % 100 == 0) {
+            seconds = (end.tv_sec - statsStart.tv_sec) + (end.tv_nsec - statsStart.tv_nsec) / 1e9;
+            printOccupancy(names, stats, occupancy, finished.capacity(), samples, seconds);
+        }
 
-        imshow("Detect", frame);
+        imshow("Detect", packet.frame);
         if (waitKey(1) == 27) break; // stop if escape key is pressed
     }
+
+    stop.store(true);
+    for (int i = 0; i < 4; ++i) {
+        queues[i]->close();
+    }
+    captureThread.join();
+    preprocessThread.join();
+    inferenceThread.join();
+    postprocessThread.join();
+
     cap.release();
     destroyAllWindows();
-    return 0;
-}
\ No newline at end of file
+    return allocationCheck.report() ? 0 : 1;
+}
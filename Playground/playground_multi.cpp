@@ -0,0 +1,159 @@
+// Overhead detection for several cameras at once: the latest frame from
+// every source is batched into one blob and each network runs once per batch.
+
+#include "utilities.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+struct StreamSource {
+    StreamSource() : sequence(0), finished(false), stop(false) {}
+
+    VideoCapture cap;
+    std::mutex lock;
+    cv::Mat latest;
+    long sequence;
+    std::atomic<bool> finished;
+    std::atomic<bool> stop;
+};
+
+// Keeps `latest` holding the newest decoded frame; older frames are simply
+// replaced, so a slow consumer never makes a camera fall behind.
+void grabFrames(StreamSource& source) {
+    cv::Mat buffer;
+    int frame_drop_limit = 100;
+
+    while (frame_drop_limit && !source.stop.load()) {
+        if(!source.cap.read(buffer)) {
+            frame_drop_limit--;
+            continue;
+        }
+        std::lock_guard<std::mutex> guard(source.lock);
+        cv::swap(buffer, source.latest);
+        source.sequence++;
+    }
+    source.finished.store(true);
+}
+
+int main(int argc, char** argv) {
+
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--max-wait" || arg == "--models" || arg == "--warmup-runs") {
+            ++i;
+            continue;
+        }
+        paths.push_back(argv[i]);
+    }
+
+    if(paths.empty()){
+        std::cerr << "Usage: "<< argv[0] << " <video_file_path> [<video_file_path> ...] [--max-wait MS] [--models DIR] [--warmup-runs N]"<<std::endl;
+        return -1;
+    }
+
+    // How long to wait for the slowest camera before batching without it.
+    int max_wait_ms = intOption(argc, argv, "--max-wait", 40);
+
+    size_t streamCount = paths.size();
+    std::vector<StreamSource> sources(streamCount);
+    for (size_t i = 0; i < streamCount; ++i) {
+        if(!sources[i].cap.open(paths[i])) {
+            std::cerr <<"Could not open video"<<paths[i]<<std::endl;
+            return -1;
+        }
+    }
+
+    setModelDirectory(stringOption(argc, argv, "--models", "."));
+    if (!loadNetworks(true, true)) return -1;
+    warmUpNetworks(intOption(argc, argv, "--warmup-runs", 1));
+
+    std::vector<std::thread> grabbers;
+    for (size_t i = 0; i < streamCount; ++i) {
+        grabbers.push_back(std::thread(grabFrames, std::ref(sources[i])));
+        cv::namedWindow(format("Stream %zu", i), cv::WINDOW_NORMAL);
+    }
+
+    std::vector<cv::Mat> frames(streamCount), batch, personOuts, faceOuts, slice;
+    std::vector<long> consumed(streamCount, 0);
+    std::vector<size_t> batchStreams;
+    std::vector<FrameContext> contexts(streamCount);
+    cv::Mat blob;
+
+    struct timespec start, end;
+    double seconds;
+    long framesDone = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (true) {
+        std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(max_wait_ms);
+        bool allFinished;
+
+        // Wait for a fresh frame from every live camera, or until the deadline.
+        while (true) {
+            size_t waiting = 0;
+            allFinished = true;
+            for (size_t i = 0; i < streamCount; ++i) {
+                std::lock_guard<std::mutex> guard(sources[i].lock);
+                bool finished = sources[i].finished.load();
+                allFinished = allFinished && finished && sources[i].sequence == consumed[i];
+                if (!finished && sources[i].sequence == consumed[i]) waiting++;
+            }
+            if (waiting == 0 || std::chrono::steady_clock::now() >= deadline) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (allFinished) break;
+
+        batch.clear();
+        batchStreams.clear();
+        for (size_t i = 0; i < streamCount; ++i) {
+            std::lock_guard<std::mutex> guard(sources[i].lock);
+            if (sources[i].sequence == consumed[i]) continue;
+            cv::swap(frames[i], sources[i].latest);
+            consumed[i] = sources[i].sequence;
+            batch.push_back(frames[i]);
+            batchStreams.push_back(i);
+        }
+        if (batch.empty()) continue;
+
+        blobFromImages(batch, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+
+        detectPeopleAndFaces(blob, personOuts, faceOuts);
+
+        int batchSize = (int)batch.size();
+        for (int k = 0; k < batchSize; ++k) {
+            cv::Mat& frame = frames[batchStreams[k]];
+            FrameContext& ctx = contexts[batchStreams[k]];
+            ctx.beginFrame();
+
+            batchSlice(personOuts, batchSize, k, slice);
+            postProcess(frame, slice, false, false, ctx);
+
+            batchSlice(faceOuts, batchSize, k, slice);
+            postProcess(frame, slice, true, false, ctx);
+
+            imshow(format("Stream %zu", batchStreams[k]), frame);
+        }
+        framesDone += batchSize;
+        reportFirstDetection();
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (seconds >= 5.0) {
+            std::cerr << format("Aggregate FPS: %.2f over %zu streams", framesDone / seconds, streamCount) << std::endl;
+            framesDone = 0;
+            start = end;
+        }
+
+        if (waitKey(1) == 27) break; // stop if escape key is pressed
+    }
+
+    for (size_t i = 0; i < streamCount; ++i) {
+        sources[i].stop.store(true);
+        grabbers[i].join();
+        sources[i].cap.release();
+    }
+    destroyAllWindows();
+    return 0;
+}
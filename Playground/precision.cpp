@@ -0,0 +1,106 @@
+#include "utilities.h"
+
+#define OPENCV_AT_LEAST(major, minor, revision) \
+    (CV_VERSION_MAJOR * 10000 + CV_VERSION_MINOR * 100 + CV_VERSION_REVISION >= (major) * 10000 + (minor) * 100 + (revision))
+
+static const char* const PRECISION_NAMES[] = {"fp32", "fp16", "int8"};
+
+bool parsePrecision(const std::string &name, Precision &precision) {
+    for (int i = 0; i < 3; ++i) {
+        if (name == PRECISION_NAMES[i]) {
+            precision = (Precision)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* precisionName(Precision precision) {
+    return PRECISION_NAMES[precision];
+}
+
+void calibrationBlob(const cv::Mat &frame, cv::Mat &blob) {
+    blobFromImage(frame, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+}
+
+bool loadCalibrationSet(const std::string &dir, std::vector<cv::Mat> &blobs) {
+    std::vector<cv::String> files;
+    cv::glob(dir + "/*.png", files, false);
+    blobs.clear();
+    for (size_t i = 0; i < files.size(); ++i) {
+        cv::Mat image = cv::imread(files[i]), blob;
+        if (image.empty()) continue;
+        calibrationBlob(image, blob);
+        blobs.push_back(blob);
+    }
+    return !blobs.empty();
+}
+
+bool setNetworkPrecision(cv::dnn::Net &net, Precision precision, const std::vector<cv::Mat> &calibration) {
+    bool cuda = cuda::getCudaEnabledDeviceCount() > 0;
+
+    switch (precision) {
+    case PRECISION_FP32:
+        return true;
+
+    case PRECISION_FP16:
+        if (cuda) {
+            net.setPreferableTarget(DNN_TARGET_CUDA_FP16);
+            return true;
+        }
+#if OPENCV_AT_LEAST(4, 9, 0)
+        net.setPreferableTarget(DNN_TARGET_CPU_FP16);
+        return true;
+#else
+        cerr << "FP16 on the CPU needs OpenCV 4.9 or newer.\n";
+        return false;
+#endif
+
+    case PRECISION_INT8:
+#if OPENCV_AT_LEAST(4, 5, 4)
+        if (calibration.empty()) {
+            cerr << "INT8 needs a calibration set (--calibration DIR, written by calibrate).\n";
+            return false;
+        }
+        try {
+            // Quantized layers only exist in the OpenCV backend on the CPU.
+            cv::dnn::Net quantized = net.quantize(calibration, CV_32F, CV_32F);
+            quantized.setPreferableBackend(DNN_BACKEND_OPENCV);
+            quantized.setPreferableTarget(DNN_TARGET_CPU);
+            net = quantized;
+            return true;
+        } catch (const cv::Exception &e) {
+            cerr << "Could not quantize the network: " << e.what() << "\n";
+            return false;
+        }
+#else
+        cerr << "INT8 needs OpenCV 4.5.4 or newer.\n";
+        return false;
+#endif
+    }
+    return false;
+}
+
+bool applyPrecisionOption(int argc, char** argv, bool person, bool face) {
+    Precision precision;
+    if (!parsePrecision(stringOption(argc, argv, "--precision", "fp32"), precision)) {
+        cerr << "--precision must be fp32, fp16 or int8\n";
+        return false;
+    }
+
+    std::vector<cv::Mat> calibration;
+    if (precision == PRECISION_INT8) {
+        std::string dir = stringOption(argc, argv, "--calibration", "calibration");
+        if (!loadCalibrationSet(dir, calibration)) {
+            cerr << "No calibration frames in " << dir << "\n";
+            return false;
+        }
+    }
+
+    if ((person && !setNetworkPrecision(personNet, precision, calibration)) ||
+        (face && !setNetworkPrecision(faceNet, precision, calibration))) {
+        return false;
+    }
+    if (precision != PRECISION_FP32) cerr << "Running in " << precisionName(precision) << "\n";
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <opencv2/dnn.hpp>
+#include <string>
+#include <vector>
+
+// Reduced-precision inference for the CPU-only edge boxes. FP16 switches
+// the target to a half-precision one; INT8 quantizes the network with
+// Net::quantize over a calibration set of frames written by `calibrate`.
+// OpenCV cannot save a quantized net, so the calibration frames are what
+// is stored and quantization is redone at startup.
+enum Precision {
+    PRECISION_FP32,
+    PRECISION_FP16,
+    PRECISION_INT8
+};
+
+// "fp32", "fp16" or "int8"; returns false for anything else.
+bool parsePrecision(const std::string&, Precision&);
+
+const char* precisionName(Precision);
+
+// Network input for one calibration or check frame, preprocessed exactly
+// like the inference path.
+void calibrationBlob(const cv::Mat&, cv::Mat&);
+
+// Reads every image in a calibration directory as a network blob.
+bool loadCalibrationSet(const std::string&, std::vector<cv::Mat>&);
+
+// Applies the precision to a configured network. INT8 replaces `net` with
+// its quantized copy. Returns false, leaving `net` in FP32, when the
+// OpenCV build or the network does not support it.
+bool setNetworkPrecision(cv::dnn::Net&, Precision, const std::vector<cv::Mat>&);
+
+// Handles --precision and --calibration DIR for the global networks a
+// program uses. Returns false after printing why it failed.
+bool applyPrecisionOption(int, char**, bool, bool);
+
+#endif
@@ -0,0 +1,138 @@
+// Accuracy and latency of a reduced-precision mode against FP32 on a
+// recorded video. Detections of the FP32 networks are the reference; a
+// reduced-precision detection matches one of the same class with IoU of at
+// least 0.5. Exits with 1 when recall falls below --min-recall.
+
+#include "utilities.h"
+#include "latency.h"
+
+const float MATCH_IOU = 0.5f;
+
+struct Agreement {
+    Agreement() : matched(0), reference(0), reduced(0) {}
+
+    long matched, reference, reduced;
+};
+
+// Greedy one-to-one matching, strongest reference detection first (the
+// NMS output is already in that order).
+void compareDetections(const std::vector<cv::Rect> &refBoxes, const std::vector<int> &refClasses,
+                       const std::vector<cv::Rect> &boxes, const std::vector<int> &classes, Agreement &agreement) {
+    std::vector<bool> used(boxes.size(), false);
+    for (size_t i = 0; i < refBoxes.size(); ++i) {
+        int best = -1;
+        float bestIou = MATCH_IOU;
+        for (size_t j = 0; j < boxes.size(); ++j) {
+            if (used[j] || classes[j] != refClasses[i]) continue;
+            float iou = 1.f - (float)cv::jaccardDistance(refBoxes[i], boxes[j]);
+            if (iou >= bestIou) {
+                bestIou = iou;
+                best = (int)j;
+            }
+        }
+        if (best >= 0) {
+            used[best] = true;
+            agreement.matched++;
+        }
+    }
+    agreement.reference += refBoxes.size();
+    agreement.reduced += boxes.size();
+}
+
+int main(int argc, char** argv) {
+
+    if(argc < 2){
+        std::cerr << "Usage: "<< argv[0] << " <video_file_path> [--precision fp16|int8] [--calibration DIR] [--frames N] [--min-recall PCT] [--models DIR]"<<std::endl;
+        return -1;
+    }
+
+    VideoCapture cap(argv[1]);
+    if(!cap.isOpened()) {
+        std::cerr <<"Could not open video"<<argv[1]<<std::endl;
+        return -1;
+    }
+
+    Precision precision;
+    if (!parsePrecision(stringOption(argc, argv, "--precision", "int8"), precision)) {
+        std::cerr << "--precision must be fp32, fp16 or int8" << std::endl;
+        return -1;
+    }
+    int frames = intOption(argc, argv, "--frames", 300);
+    double minRecall = intOption(argc, argv, "--min-recall", 95) / 100.0;
+
+    std::vector<cv::Mat> calibration;
+    if (precision == PRECISION_INT8) {
+        std::string dir = stringOption(argc, argv, "--calibration", "calibration");
+        if (!loadCalibrationSet(dir, calibration)) {
+            std::cerr << "No calibration frames in " << dir << std::endl;
+            return -1;
+        }
+    }
+
+    setModelDirectory(stringOption(argc, argv, "--models", "."));
+    DetectorNets baseline, reduced;
+    if (!loadDetectorNets(baseline, true, true) || !loadDetectorNets(reduced, true, true)) {
+        std::cerr << "Could not load the neural networks" << std::endl;
+        return -1;
+    }
+    if (!setNetworkPrecision(reduced.person, precision, calibration) ||
+        !setNetworkPrecision(reduced.face, precision, calibration)) {
+        return -1;
+    }
+
+    // Index 0 is the person network, 1 the face network.
+    LatencyHistogram baselineMs[2] = {LatencyHistogram("person fp32"), LatencyHistogram("face fp32")};
+    LatencyHistogram reducedMs[2] = {LatencyHistogram(format("person %s", precisionName(precision))),
+                                     LatencyHistogram(format("face %s", precisionName(precision)))};
+    Agreement agreement[2];
+
+    cv::Mat frame, blob;
+    std::vector<cv::Mat> outs;
+    FrameContext ctx;
+    DecodedBoxes reference, detections;
+
+    for (int n = 0; n < frames && cap.read(frame); ++n) {
+        calibrationBlob(frame, blob);
+        cv::Rect region(0, 0, frame.cols, frame.rows);
+
+        for (int face = 0; face < 2; ++face) {
+            std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+            face ? detectFaces(baseline, blob, outs) : detectPeople(baseline, blob, outs);
+            baselineMs[face].add(lapMs(t));
+            getDetections(outs, region, face, ctx, reference);
+
+            t = std::chrono::steady_clock::now();
+            face ? detectFaces(reduced, blob, outs) : detectPeople(reduced, blob, outs);
+            reducedMs[face].add(lapMs(t));
+            getDetections(outs, region, face, ctx, detections);
+
+            compareDetections(reference.boxes, reference.classIds, detections.boxes, detections.classIds, agreement[face]);
+        }
+
+        // The first forward includes one-off allocation and setup.
+        if (n == 0) {
+            for (int i = 0; i < 2; ++i) {
+                baselineMs[i].clear();
+                reducedMs[i].clear();
+            }
+        }
+    }
+
+    bool pass = true;
+    printf("%-12s %10s %10s %8s %8s %10s\n", "network", "fp32 ms", "ms", "speedup", "recall", "precision");
+    for (int face = 0; face < 2; ++face) {
+        const Agreement &a = agreement[face];
+        double recall = a.reference > 0 ? (double)a.matched / a.reference : 1.0;
+        double agreementPrecision = a.reduced > 0 ? (double)a.matched / a.reduced : 1.0;
+        printf("%-12s %10.3f %10.3f %7.2fx %8.3f %10.3f\n", reducedMs[face].getName().c_str(),
+               baselineMs[face].mean(), reducedMs[face].mean(), baselineMs[face].mean() / reducedMs[face].mean(),
+               recall, agreementPrecision);
+        pass = pass && recall >= minRecall;
+    }
+
+    if (!pass) {
+        std::cerr << "Recall against fp32 is below " << minRecall << std::endl;
+        return 1;
+    }
+    return 0;
+}
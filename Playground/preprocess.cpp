@@ -0,0 +1,223 @@
+#include "preprocess.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cstring>
+
+// Value of the letterbox border, as in darknet.
+const float LETTERBOX_FILL = 0.5f;
+
+// Output rows per parallel_for_ stripe.
+const int ROWS_PER_STRIPE = 16;
+
+// Fixed-point precision of the horizontal weights. A (left, right) pair of
+// 8-bit samples dotted with the pair sums to at most 255 << 14 and each
+// weight fits a short.
+const int WEIGHT_BITS = 14;
+const float WEIGHT_ONE = (float)(1 << WEIGHT_BITS);
+
+// Source sample positions for one axis, with the pixel-center convention
+// and border clamping of cv::resize(INTER_LINEAR).
+static void buildAxis(int srcLength, int dstLength, int step, std::vector<int> &left, std::vector<int> &right,
+                      std::vector<float> &weights) {
+    double scale = (double)srcLength / dstLength;
+    left.resize(dstLength);
+    right.resize(dstLength);
+    weights.resize(dstLength);
+    for (int i = 0; i < dstLength; ++i) {
+        float f = (float)((i + 0.5) * scale - 0.5);
+        int i0 = cvFloor(f);
+        float w = f - i0;
+        if (i0 < 0) {
+            i0 = 0;
+            w = 0.f;
+        }
+        if (i0 >= srcLength - 1) {
+            i0 = srcLength - 1;
+            w = 0.f;
+        }
+        left[i] = i0 * step;
+        right[i] = (w > 0.f ? i0 + 1 : i0) * step;
+        weights[i] = w;
+    }
+}
+
+static void buildPlan(const cv::Size &frameSize, const cv::Size &inputSize, bool letterbox, PreprocessPlan &plan) {
+    plan.frameSize = frameSize;
+    plan.inputSize = inputSize;
+    plan.letterbox = letterbox;
+
+    plan.content = cv::Rect(0, 0, inputSize.width, inputSize.height);
+    if (letterbox) {
+        double s = std::min((double)inputSize.width / frameSize.width, (double)inputSize.height / frameSize.height);
+        int w = std::max(1, cvRound(frameSize.width * s)), h = std::max(1, cvRound(frameSize.height * s));
+        plan.content = cv::Rect((inputSize.width - w) / 2, (inputSize.height - h) / 2, w, h);
+    }
+
+    // The whole network input expressed in frame coordinates; with a
+    // letterbox it reaches past the frame by the border.
+    double fx = (double)frameSize.width / plan.content.width, fy = (double)frameSize.height / plan.content.height;
+    plan.region = cv::Rect(cvRound(-plan.content.x * fx), cvRound(-plan.content.y * fy),
+                           cvRound(inputSize.width * fx), cvRound(inputSize.height * fy));
+
+    std::vector<int> unused;
+    buildAxis(frameSize.width, plan.content.width, 3, plan.xLeft, plan.xRight, plan.xWeights);
+    buildAxis(frameSize.height, plan.content.height, 1, plan.yRows, unused, plan.yWeights);
+
+    // Low short (1 - w), high short w; the two always sum to WEIGHT_ONE.
+    plan.xPairs.resize(plan.content.width);
+    for (int i = 0; i < plan.content.width; ++i) {
+        int w = cvRound(plan.xWeights[i] * WEIGHT_ONE);
+        plan.xPairs[i] = ((1 << WEIGHT_BITS) - w) | (w << 16);
+    }
+
+    // A 4-byte load at a pixel reads one byte of the next; only the last
+    // source pixel of a row has none. xRight never decreases, so the
+    // columns before the first one that reaches it can all use 4-byte loads.
+    int lastPixel = (frameSize.width - 1) * 3, columns = 0;
+    while (columns < plan.content.width && plan.xRight[columns] < lastPixel) ++columns;
+    plan.xSimdColumns = columns & ~3;
+}
+
+#if CV_SIMD128
+static inline unsigned loadPixel(const uchar *p) {
+    unsigned v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Horizontal interpolation of four output pixels from one source row, as
+// B, G, R, unused floats scaled by WEIGHT_ONE. Each source pixel is one
+// 4-byte load; left and right samples are zipped into 16-bit pairs and
+// dotted with the pixel's weight pair, as cv::resize's fixed-point path does.
+static inline void interpolate4(const uchar *row, const int *left, const int *right, const int *pairs, float *out) {
+    cv::v_uint8x16 l = cv::v_reinterpret_as_u8(cv::v_uint32x4(loadPixel(row + left[0]), loadPixel(row + left[1]),
+                                                              loadPixel(row + left[2]), loadPixel(row + left[3])));
+    cv::v_uint8x16 r = cv::v_reinterpret_as_u8(cv::v_uint32x4(loadPixel(row + right[0]), loadPixel(row + right[1]),
+                                                              loadPixel(row + right[2]), loadPixel(row + right[3])));
+    cv::v_uint8x16 lr01, lr23;
+    cv::v_zip(l, r, lr01, lr23);
+    cv::v_uint16x8 p[4];
+    cv::v_expand(lr01, p[0], p[1]);
+    cv::v_expand(lr23, p[2], p[3]);
+    for (int k = 0; k < 4; ++k) {
+        cv::v_int32x4 sum = cv::v_dotprod(cv::v_reinterpret_as_s16(p[k]), cv::v_reinterpret_as_s16(cv::v_setall_s32(pairs[k])));
+        cv::v_store(out + k * 4, cv::v_cvt_f32(sum));
+    }
+}
+#endif
+
+// Scalar counterpart of interpolate4 for one pixel; bit-identical to it.
+static inline void interpolate1(const uchar *row, int left, int right, int pair, float *out) {
+    int wLeft = pair & 0xffff, wRight = pair >> 16;
+    for (int c = 0; c < 3; ++c) {
+        out[c] = (float)(row[left + c] * wLeft + row[right + c] * wRight);
+    }
+}
+
+class PreprocessBody : public cv::ParallelLoopBody {
+public:
+    PreprocessBody(const cv::Mat &frame, const PreprocessPlan &plan, cv::Mat &blob)
+        : frame(frame), plan(plan), planes((float*)blob.data) {}
+
+    void operator()(const cv::Range &range) const {
+        // Horizontally interpolated upper and lower source rows as B, G, R,
+        // unused per pixel, scaled by WEIGHT_ONE; one pair per thread.
+        static thread_local std::vector<float> upper, lower;
+        const cv::Rect &content = plan.content;
+        const int width = plan.inputSize.width, height = plan.inputSize.height;
+        const size_t planeSize = (size_t)width * height;
+        upper.resize(content.width * 4);
+        lower.resize(content.width * 4);
+
+        for (int y = range.start; y < range.end; ++y) {
+            // Plane 0 is R, so it takes source channel 2.
+            float *r = planes + (size_t)y * width, *g = r + planeSize, *b = g + planeSize;
+
+            if (y < content.y || y >= content.y + content.height) {
+                std::fill(r, r + width, LETTERBOX_FILL);
+                std::fill(g, g + width, LETTERBOX_FILL);
+                std::fill(b, b + width, LETTERBOX_FILL);
+                continue;
+            }
+
+            int cy = y - content.y;
+            float wy = plan.yWeights[cy];
+            const uchar *top = frame.ptr<uchar>(plan.yRows[cy]);
+            const uchar *bottom = frame.ptr<uchar>(wy > 0.f ? plan.yRows[cy] + 1 : plan.yRows[cy]);
+
+            int i = 0;
+#if CV_SIMD128
+            for (; i < plan.xSimdColumns; i += 4) {
+                interpolate4(top, &plan.xLeft[i], &plan.xRight[i], &plan.xPairs[i], &upper[i * 4]);
+                interpolate4(bottom, &plan.xLeft[i], &plan.xRight[i], &plan.xPairs[i], &lower[i * 4]);
+            }
+#endif
+            for (; i < content.width; ++i) {
+                interpolate1(top, plan.xLeft[i], plan.xRight[i], plan.xPairs[i], &upper[i * 4]);
+                interpolate1(bottom, plan.xLeft[i], plan.xRight[i], plan.xPairs[i], &lower[i * 4]);
+            }
+
+            // Vertical blend with the 1/255 and fixed-point scales folded
+            // into the weights, de-interleaved straight into the three planes.
+            const float wTop = (1.f - wy) / (255.f * WEIGHT_ONE), wBottom = wy / (255.f * WEIGHT_ONE);
+            const float *u = &upper[0], *l = &lower[0];
+            float *outR = r + content.x, *outG = g + content.x, *outB = b + content.x;
+            i = 0;
+#if CV_SIMD128
+            cv::v_float32x4 vTop = cv::v_setall_f32(wTop), vBottom = cv::v_setall_f32(wBottom);
+            for (; i + 4 <= content.width; i += 4) {
+                cv::v_float32x4 u0, u1, u2, u3, l0, l1, l2, l3;
+                cv::v_load_deinterleave(u + i * 4, u0, u1, u2, u3);
+                cv::v_load_deinterleave(l + i * 4, l0, l1, l2, l3);
+                cv::v_store(outB + i, cv::v_muladd(l0, vBottom, cv::v_muladd(u0, vTop, cv::v_setzero_f32())));
+                cv::v_store(outG + i, cv::v_muladd(l1, vBottom, cv::v_muladd(u1, vTop, cv::v_setzero_f32())));
+                cv::v_store(outR + i, cv::v_muladd(l2, vBottom, cv::v_muladd(u2, vTop, cv::v_setzero_f32())));
+            }
+#endif
+            for (; i < content.width; ++i) {
+                outB[i] = u[i * 4] * wTop + l[i * 4] * wBottom;
+                outG[i] = u[i * 4 + 1] * wTop + l[i * 4 + 1] * wBottom;
+                outR[i] = u[i * 4 + 2] * wTop + l[i * 4 + 2] * wBottom;
+            }
+
+            if (content.x > 0 || content.width < width) {
+                int rightPad = content.x + content.width;
+                std::fill(r, r + content.x, LETTERBOX_FILL);
+                std::fill(g, g + content.x, LETTERBOX_FILL);
+                std::fill(b, b + content.x, LETTERBOX_FILL);
+                std::fill(r + rightPad, r + width, LETTERBOX_FILL);
+                std::fill(g + rightPad, g + width, LETTERBOX_FILL);
+                std::fill(b + rightPad, b + width, LETTERBOX_FILL);
+            }
+        }
+    }
+
+private:
+    const cv::Mat &frame;
+    const PreprocessPlan &plan;
+    float *planes;
+};
+
+cv::Rect preprocessFrame(const cv::Mat &frame, const cv::Size &inputSize, bool letterbox, PreprocessPlan &plan, cv::Mat &blob) {
+    CV_Assert(frame.type() == CV_8UC3 && !frame.empty());
+
+    if (plan.frameSize != frame.size() || plan.inputSize != inputSize || plan.letterbox != letterbox) {
+        buildPlan(frame.size(), inputSize, letterbox, plan);
+    }
+
+    int shape[] = {1, 3, inputSize.height, inputSize.width};
+    blob.create(4, shape, CV_32F);
+
+    PreprocessBody body(frame, plan, blob);
+    cv::parallel_for_(cv::Range(0, inputSize.height), body, std::max(1, inputSize.height / ROWS_PER_STRIPE));
+    return plan.region;
+}
+
+cv::Rect preprocessFrame(const cv::Mat &frame, const cv::Size &inputSize, bool letterbox, PreprocessPlan &plan,
+                         cv::Mat &blob, const cv::Size &displaySize) {
+    cv::Rect region = preprocessFrame(frame, inputSize, letterbox, plan, blob);
+    double sx = (double)displaySize.width / frame.cols, sy = (double)displaySize.height / frame.rows;
+    return cv::Rect(cvRound(region.x * sx), cvRound(region.y * sy),
+                    cvRound(region.width * sx), cvRound(region.height * sy));
+}
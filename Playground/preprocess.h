@@ -0,0 +1,50 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Fused replacement for blobFromImage(frame, blob, 1/255.0, size, Scalar(),
+// true, false): bilinear resize, BGR to RGB, scaling and the HWC to CHW
+// transpose happen in one pass over the output, split into row stripes
+// across OpenCV's thread pool, writing into a blob that is only allocated
+// when the input size changes. Both interpolation steps use universal
+// intrinsics; the horizontal one with Q14 fixed-point weights like
+// cv::resize. Values match blobFromImage to within the rounding of OpenCV's
+// fixed-point resize.
+//
+// With letterboxing the frame keeps its aspect ratio and the unused border
+// of the network input is filled with gray (0.5), as darknet does.
+
+// Interpolation tables for one frame size / input size pair; rebuilt only
+// when either changes. Keep one per stream.
+struct PreprocessPlan {
+    PreprocessPlan() : letterbox(false), xSimdColumns(0) {}
+
+    cv::Size frameSize;
+    cv::Size inputSize;
+    bool letterbox;
+    cv::Rect content;               // part of the input the frame is drawn into
+    cv::Rect region;                // frame-coordinate rectangle the whole input covers
+    std::vector<int> xLeft;         // byte offset of the left source pixel, per content column
+    std::vector<int> xRight;        // same for the right one (equal at the border)
+    std::vector<float> xWeights;
+    std::vector<int> xPairs;        // xWeights as a Q14 (1 - w, w) pair of shorts, per content column
+    int xSimdColumns;               // leading content columns read with 4-byte loads that stay inside the row
+    std::vector<int> yRows;         // upper source row, per content row
+    std::vector<float> yWeights;
+};
+
+// Fills `blob` (1x3xHxW, CV_32F) from an 8-bit BGR frame and returns the
+// rectangle of the frame, in frame coordinates, that the network input
+// covers; pass it to getDetections/getBoxes as the region. Without
+// letterboxing it is simply the whole frame.
+cv::Rect preprocessFrame(const cv::Mat&, const cv::Size&, bool, PreprocessPlan&, cv::Mat&);
+
+// Same, for a capture that is shown, tracked and drawn on at `displaySize`:
+// the blob is built from the full-resolution capture, so the network input
+// is resampled once rather than capture to display to network, and the
+// returned region is in display coordinates.
+cv::Rect preprocessFrame(const cv::Mat&, const cv::Size&, bool, PreprocessPlan&, cv::Mat&, const cv::Size&);
+
+#endif
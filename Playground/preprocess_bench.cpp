@@ -0,0 +1,43 @@
+// Timing of the fused preprocessing kernel against blobFromImage for
+// 720p, 1080p and 4K frames going into the 416x416 network input, plus the
+// largest difference between the two blobs.
+
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+#include <chrono>
+#include <cstdio>
+#include "preprocess.h"
+
+template <typename F>
+double timeMs(F f, int repeats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+int main() {
+    const cv::Size frameSizes[] = {cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160)};
+    const cv::Size inputSize(416, 416);
+    const int repeats = 100;
+    cv::RNG rng(12345);
+
+    printf("%-10s %16s %12s %16s %12s\n", "frame", "blobFromImage ms", "fused ms", "letterbox ms", "max diff");
+    for (size_t s = 0; s < sizeof(frameSizes) / sizeof(frameSizes[0]); ++s) {
+        cv::Mat frame(frameSizes[s], CV_8UC3);
+        rng.fill(frame, cv::RNG::UNIFORM, 0, 256);
+
+        cv::Mat reference, fused, boxed;
+        PreprocessPlan plan, boxedPlan;
+
+        double referenceMs = timeMs([&]() {
+            cv::dnn::blobFromImage(frame, reference, 1/255.0, inputSize, cv::Scalar(0, 0, 0), true, false);
+        }, repeats);
+        double fusedMs = timeMs([&]() { preprocessFrame(frame, inputSize, false, plan, fused); }, repeats);
+        double boxedMs = timeMs([&]() { preprocessFrame(frame, inputSize, true, boxedPlan, boxed); }, repeats);
+
+        double maxDiff = cv::norm(reference, fused, cv::NORM_INF);
+        printf("%4dx%-5d %16.3f %12.3f %16.3f %12.5f\n", frame.cols, frame.rows,
+               referenceMs, fusedMs, boxedMs, maxDiff);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "recorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+bool parseRecordPolicy(const std::string &name, RecordPolicy &policy) {
+    if (name == "drop") policy = RECORD_DROP;
+    else if (name == "block") policy = RECORD_BLOCK;
+    else return false;
+    return true;
+}
+
+// Codec for every extension; mp4v plays everywhere OpenCV's FFmpeg does.
+static int recordFourcc() {
+    return cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+}
+
+VideoRecorder::VideoRecorder(const std::string &path, double fps, long segmentFrames, RecordPolicy policy, size_t depth)
+    : path(path), fps(fps > 0 ? fps : 30.0), segmentFrames(segmentFrames), policy(policy), segmentWritten(0),
+      ring(std::max<size_t>(depth, 1)), head(0), count(0), stopping(false),
+      writtenCount(0), droppedCount(0), segmentCount(0) {}
+
+VideoRecorder::~VideoRecorder() {
+    stop();
+}
+
+void VideoRecorder::start() {
+    if (encoder.joinable()) return;
+    stopping = false;
+    encoder = std::thread(&VideoRecorder::run, this);
+}
+
+std::string VideoRecorder::segmentPath(int index) const {
+    if (segmentFrames <= 0 && index == 0) return path;
+
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "_%03d", index);
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+bool VideoRecorder::openSegment(const cv::Size &size) {
+    writer.release();
+    std::string file = segmentPath(segmentCount.load());
+    if (!writer.open(file, recordFourcc(), fps, size, true)) {
+        std::cerr << "Could not open " << file << " for recording" << std::endl;
+        return false;
+    }
+    segmentSize = size;
+    segmentWritten = 0;
+    segmentCount++;
+    return true;
+}
+
+bool VideoRecorder::submit(const cv::Mat &frame) {
+    frame.copyTo(staging);
+
+    std::unique_lock<std::mutex> guard(lock);
+    if (count == ring.size()) {
+        if (policy == RECORD_DROP) {
+            droppedCount++;
+            return false;
+        }
+        space.wait(guard, [&] { return stopping || count < ring.size(); });
+        if (stopping) return false;
+    }
+    cv::swap(staging, ring[(head + count) % ring.size()]);
+    count++;
+    ready.notify_one();
+    return true;
+}
+
+void VideoRecorder::run() {
+    cv::Mat frame;
+    bool failed = false;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [&] { return stopping || count > 0; });
+            if (count == 0) break;      // stopping and drained
+            cv::swap(frame, ring[head]);
+            head = (head + 1) % ring.size();
+            count--;
+            space.notify_one();
+        }
+
+        // A file that cannot be opened is reported once; the frames are
+        // still consumed so the caller is never stalled by it.
+        bool rotate = !writer.isOpened() || (segmentFrames > 0 && segmentWritten >= segmentFrames) ||
+                      frame.size() != segmentSize;
+        if (rotate && !failed && !openSegment(frame.size())) failed = true;
+        if (failed) {
+            droppedCount++;
+            continue;
+        }
+
+        writer.write(frame);
+        segmentWritten++;
+        writtenCount++;
+    }
+    writer.release();
+}
+
+void VideoRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        ready.notify_all();
+        space.notify_all();
+    }
+    if (encoder.joinable()) encoder.join();
+}
+
+size_t VideoRecorder::queued() {
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+}
@@ -0,0 +1,84 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes processed frames to video files on a dedicated encoder thread, so
+// encoding never runs inside the detection loop.
+//
+// submit() copies the frame into a bounded ring of reused buffers and
+// returns; later drawing on the caller's frame never reaches the file.
+// Call it only once the frame has been anonymized, since whatever is
+// submitted is what gets written. When the encoder falls behind,
+// RECORD_DROP discards the new frame (detection keeps its frame rate) and
+// RECORD_BLOCK waits for a free slot (every frame is kept).
+//
+// With a segment length, output rotates to a new file every that many
+// frames: out.mp4 becomes out_000.mp4, out_001.mp4, ... A change of frame
+// size also starts a new file; without a segment length the first file is
+// out.mp4 and later ones are numbered from out_001.mp4, so nothing already
+// written is overwritten.
+enum RecordPolicy {
+    RECORD_DROP,
+    RECORD_BLOCK
+};
+
+bool parseRecordPolicy(const std::string&, RecordPolicy&);
+
+class VideoRecorder {
+public:
+    VideoRecorder(const std::string &path, double fps, long segmentFrames, RecordPolicy policy, size_t depth = 8);
+    ~VideoRecorder();
+
+    // Starts the encoder thread; files are opened on the first frame of each
+    // segment, at that frame's size.
+    void start();
+
+    // Queues a copy of `frame`; false when it was dropped.
+    bool submit(const cv::Mat &frame);
+
+    // Writes everything queued, closes the current file and stops.
+    void stop();
+
+    long written() const { return writtenCount.load(); }
+    long dropped() const { return droppedCount.load(); }
+    int segments() const { return segmentCount.load(); }
+
+    // Frames waiting for the encoder.
+    size_t queued();
+
+private:
+    void run();
+    bool openSegment(const cv::Size &size);
+    std::string segmentPath(int index) const;
+
+    std::string path;
+    double fps;
+    long segmentFrames;
+    RecordPolicy policy;
+
+    cv::VideoWriter writer;     // encoder thread only
+    cv::Size segmentSize;
+    long segmentWritten;
+    cv::Mat staging;            // caller thread only
+
+    std::mutex lock;
+    std::condition_variable ready;  // a frame was queued, or stop()
+    std::condition_variable space;  // a slot was freed
+    std::vector<cv::Mat> ring;
+    size_t head, count;
+    bool stopping;
+    std::thread encoder;
+
+    std::atomic<long> writtenCount, droppedCount;
+    std::atomic<int> segmentCount;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "resolution_controller.h"
+
+#include <algorithm>
+
+const int SIZE_STEP = 32;
+
+// EWMA weight of the newest frame.
+const double SMOOTHING = 0.2;
+
+// Over budget: average above budget * DROP_RATIO for DROP_FRAMES frames, or
+// a single frame above budget * SPIKE_RATIO. Headroom: average below
+// budget * RAISE_RATIO for RAISE_FRAMES frames.
+const double DROP_RATIO = 1.1;
+const int DROP_FRAMES = 3;
+const double SPIKE_RATIO = 2.0;
+const double RAISE_RATIO = 0.7;
+const int RAISE_FRAMES = 30;
+
+// Frames ignored after a change while the new size settles (the network
+// reallocates its buffers on the first frame at a new shape).
+const int COOLDOWN_FRAMES = 10;
+
+static int roundToStep(int size) {
+    return std::max(SIZE_STEP, (size + SIZE_STEP / 2) / SIZE_STEP * SIZE_STEP);
+}
+
+ResolutionController::ResolutionController(double budgetMs, int initialSize, int minSize, int maxSize)
+    : budgetMs(budgetMs), minSize(roundToStep(minSize)), maxSize(roundToStep(std::max(minSize, maxSize))),
+      current(std::min(this->maxSize, std::max(this->minSize, roundToStep(initialSize)))),
+      average(0.0), over(0), under(0), cooldown(0), changeCount(0) {}
+
+void ResolutionController::record(double frameMs) {
+    if (cooldown > 0) {
+        --cooldown;
+        return;
+    }
+    average = average > 0.0 ? SMOOTHING * frameMs + (1 - SMOOTHING) * average : frameMs;
+
+    if (frameMs > budgetMs * SPIKE_RATIO) {
+        resize(-2);
+        return;
+    }
+
+    over = average > budgetMs * DROP_RATIO ? over + 1 : 0;
+    under = average < budgetMs * RAISE_RATIO ? under + 1 : 0;
+    if (over >= DROP_FRAMES) {
+        resize(-1);
+    } else if (under >= RAISE_FRAMES) {
+        resize(1);
+    }
+}
+
+void ResolutionController::resize(int steps) {
+    int next = std::min(maxSize, std::max(minSize, current + steps * SIZE_STEP));
+    over = under = 0;
+    if (next == current) return;
+
+    // Forward cost grows with the pixel count; rescale the average so the
+    // new size starts from an estimate rather than from the old timings.
+    double ratio = (double)next / current;
+    average *= ratio * ratio;
+    current = next;
+    cooldown = COOLDOWN_FRAMES;
+    ++changeCount;
+}
@@ -0,0 +1,33 @@
+#ifndef RESOLUTION_CONTROLLER_H
+#define RESOLUTION_CONTROLLER_H
+
+// Picks the network input size (a multiple of 32, square) per frame so the
+// frame time stays within a budget. Frame times are smoothed with an EWMA.
+// The size drops one step once the average has been over budget for a few
+// frames, or two steps at once on a spike. It rises one step only after a
+// long stretch well under budget. The gap between the two thresholds and
+// the cooldown after every change keep it from oscillating.
+class ResolutionController {
+public:
+    ResolutionController(double budgetMs, int initialSize = 416, int minSize = 320, int maxSize = 608);
+
+    // Feeds the time the last frame took, in milliseconds.
+    void record(double frameMs);
+
+    int size() const { return current; }
+
+    double averageMs() const { return average; }
+
+    long changes() const { return changeCount; }
+
+private:
+    void resize(int steps);
+
+    double budgetMs;
+    int minSize, maxSize, current;
+    double average;
+    int over, under, cooldown;
+    long changeCount;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "skin_prefilter.h"
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cstdio>
+
+// Width of the analysis image; the height follows the aspect ratio.
+const int ANALYSIS_WIDTH = 320;
+
+// Skin range in OpenCV's HSV (H 0..180), as in LBP/lbp.cpp.
+const cv::Scalar SKIN_LOW(0, 30, 60);
+const cv::Scalar SKIN_HIGH(20, 150, 255);
+
+// Width / height of a blob that could be a face. Looser than the LBP demo,
+// since a face often merges with the neck or a hand at this resolution.
+const float MIN_ASPECT = 0.4f;
+const float MAX_ASPECT = 2.0f;
+
+// Margin added around each candidate, as a fraction of its size.
+const float REGION_MARGIN = 0.25f;
+
+SkinPrefilter::SkinPrefilter(int minBlobArea)
+    : minBlobArea(minBlobArea), lastPassed(true), frames(0), rejected(0),
+      auditedFrames(0), facesSeen(0), facesMissed(0), framesMissed(0) {
+    openKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
+    closeKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5));
+}
+
+bool SkinPrefilter::analyze(const cv::Mat &frame) {
+    ++frames;
+    candidates.clear();
+
+    int height = std::max(1, cvRound((double)frame.rows * ANALYSIS_WIDTH / frame.cols));
+    cv::resize(frame, small, cv::Size(ANALYSIS_WIDTH, height), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small, hsv, cv::COLOR_BGR2HSV);
+    cv::inRange(hsv, SKIN_LOW, SKIN_HIGH, mask);
+    cv::morphologyEx(mask, mask, cv::MORPH_OPEN, openKernel);
+    cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, closeKernel);
+    cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    double sx = (double)frame.cols / small.cols, sy = (double)frame.rows / small.rows;
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    for (size_t i = 0; i < contours.size(); ++i) {
+        cv::Rect blob = cv::boundingRect(contours[i]);
+        float aspect = (float)blob.width / blob.height;
+        if (blob.area() < minBlobArea || aspect < MIN_ASPECT || aspect > MAX_ASPECT) continue;
+
+        int mx = cvRound(blob.width * REGION_MARGIN), my = cvRound(blob.height * REGION_MARGIN);
+        cv::Rect region(cvRound((blob.x - mx) * sx), cvRound((blob.y - my) * sy),
+                        cvRound((blob.width + 2 * mx) * sx), cvRound((blob.height + 2 * my) * sy));
+        candidates.push_back(region & frameRect);
+    }
+
+    lastPassed = !candidates.empty();
+    if (!lastPassed) ++rejected;
+    return lastPassed;
+}
+
+void SkinPrefilter::audit(const std::vector<cv::Rect> &faces) {
+    ++auditedFrames;
+    long missed = 0;
+    for (size_t i = 0; i < faces.size(); ++i) {
+        bool covered = false;
+        for (size_t k = 0; lastPassed && k < candidates.size() && !covered; ++k) {
+            covered = (faces[i] & candidates[k]).area() > 0;
+        }
+        if (!covered) ++missed;
+    }
+    facesSeen += (long)faces.size();
+    facesMissed += missed;
+    if (!lastPassed && !faces.empty()) ++framesMissed;
+}
+
+std::string SkinPrefilter::report() const {
+    char line[256];
+    int n = snprintf(line, sizeof(line), "Skin prefilter skipped the face net on %.1f%% of %ld frames",
+                     rejectedFraction() * 100, frames);
+    if (auditedFrames > 0 && n > 0 && n < (int)sizeof(line)) {
+        snprintf(line + n, sizeof(line) - n, "; audit: missed %ld of %ld faces (%.1f%%), %ld frames with faces rejected",
+                 facesMissed, facesSeen, facesSeen > 0 ? 100.0 * facesMissed / facesSeen : 0.0, framesMissed);
+    }
+    return line;
+}
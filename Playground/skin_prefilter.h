@@ -0,0 +1,55 @@
+#ifndef SKIN_PREFILTER_H
+#define SKIN_PREFILTER_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// Cheap CPU test for whether a frame can contain a face at all, taken from
+// the LBP demo: an HSV skin mask at low resolution, cleaned with an
+// opening and a closing, whose face-shaped blobs are the candidates. The
+// face net is only run on frames with at least one candidate.
+//
+// The decision threshold is the smallest blob area, in pixels of the
+// 320-pixel-wide analysis image, that counts as a candidate. Lower it for
+// cameras where faces are small; raise it to skip more frames.
+//
+// In audit mode the caller runs the face net regardless and passes its
+// detections to audit(), which counts the faces the prefilter would have
+// cost us.
+class SkinPrefilter {
+public:
+    explicit SkinPrefilter(int minBlobArea = 40);
+
+    // True when `frame` (BGR) has face-like skin blobs; regions() then holds
+    // them in frame coordinates, with a margin.
+    bool analyze(const cv::Mat &frame);
+
+    const std::vector<cv::Rect> &regions() const { return candidates; }
+
+    // Compares the last analyze() with the face net's detections on the
+    // same frame. A face is missed when the frame was rejected or the face
+    // overlaps none of the regions.
+    void audit(const std::vector<cv::Rect> &faces);
+
+    // Fraction of analyzed frames the face net was skipped for.
+    double rejectedFraction() const { return frames > 0 ? (double)rejected / frames : 0.0; }
+
+    long frameCount() const { return frames; }
+
+    // One-line summary, including the audit counts when there are any.
+    std::string report() const;
+
+private:
+    int minBlobArea;
+    bool lastPassed;
+
+    cv::Mat small, hsv, mask, openKernel, closeKernel;
+    std::vector<std::vector<cv::Point> > contours;
+    std::vector<cv::Rect> candidates;
+
+    long frames, rejected;
+    long auditedFrames, facesSeen, facesMissed, framesMissed;
+};
+
+#endif
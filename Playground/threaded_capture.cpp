@@ -0,0 +1,145 @@
+#include "threaded_capture.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Consecutive failed reads that end a file, and that make a live source
+// reconnect.
+const int FILE_FAILURE_LIMIT = 100;
+const int LIVE_FAILURE_LIMIT = 10;
+
+// Reconnect backoff, doubled after every failed attempt.
+const std::chrono::milliseconds FIRST_RETRY(500);
+const std::chrono::milliseconds LAST_RETRY(8000);
+
+// Lateness limit when the source does not report a frame rate.
+const std::chrono::microseconds DEFAULT_LATE_LIMIT(100000);
+
+bool isLiveSource(const std::string &source) {
+    return source.compare(0, 7, "rtsp://") == 0 || source.compare(0, 10, "/dev/video") == 0 ||
+           (!source.empty() && source.find_first_not_of("0123456789") == std::string::npos);
+}
+
+ThreadedCapture::ThreadedCapture(const std::string &source, CapturePolicy policy, size_t depth)
+    : source(source), policy(policy), live(isLiveSource(source)), fps(0.0), lateLimit(DEFAULT_LATE_LIMIT),
+      ring(std::max<size_t>(depth, 1)), stamps(ring.size()), head(0), count(0), finished(false), stopping(false),
+      capturedCount(0), droppedCount(0), lateCount(0), reconnectCount(0) {}
+
+ThreadedCapture::~ThreadedCapture() {
+    stop();
+}
+
+bool ThreadedCapture::connect() {
+    cap.release();
+    bool opened = source.find_first_not_of("0123456789") == std::string::npos
+        ? cap.open(atoi(source.c_str()))
+        : cap.open(source);
+    return opened && cap.isOpened();
+}
+
+bool ThreadedCapture::open() {
+    if (!connect()) return false;
+
+    fps = cap.get(cv::CAP_PROP_FPS);
+    if (fps > 0.0) lateLimit = std::chrono::microseconds((long)(2e6 / fps));
+    decoder = std::thread(&ThreadedCapture::run, this);
+    return true;
+}
+
+void ThreadedCapture::run() {
+    cv::Mat decoded;
+    int failures = 0;
+    long index = 0;
+    std::chrono::milliseconds retry = FIRST_RETRY;
+
+    while (true) {
+        bool ok = cap.grab();
+        std::chrono::steady_clock::time_point stamp = std::chrono::steady_clock::now();
+        ok = ok && cap.retrieve(decoded) && !decoded.empty();
+
+        if (!ok) {
+            if (++failures < (live ? LIVE_FAILURE_LIMIT : FILE_FAILURE_LIMIT)) continue;
+            if (!live) break;
+
+            // Wait out the backoff (or a stop), then reopen.
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (space.wait_for(guard, retry, [&] { return stopping; })) break;
+            }
+            retry = std::min(retry * 2, LAST_RETRY);
+            if (connect()) {
+                reconnectCount++;
+                failures = 0;
+            }
+            continue;
+        }
+        failures = 0;
+        retry = FIRST_RETRY;
+
+        std::unique_lock<std::mutex> guard(lock);
+        if (count == ring.size()) {
+            if (policy == CAPTURE_LATEST_FRAME) {
+                head = (head + 1) % ring.size();
+                count--;
+                droppedCount++;
+            } else {
+                space.wait(guard, [&] { return stopping || count < ring.size(); });
+            }
+        }
+        if (stopping) break;
+
+        size_t slot = (head + count) % ring.size();
+        cv::swap(decoded, ring[slot]);
+        stamps[slot].index = index++;
+        stamps[slot].captured = stamp;
+        count++;
+        capturedCount++;
+        ready.notify_one();
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    finished = true;
+    ready.notify_all();
+}
+
+bool ThreadedCapture::read(cv::Mat &frame) {
+    FrameStamp stamp;
+    return read(frame, stamp);
+}
+
+bool ThreadedCapture::read(cv::Mat &frame, FrameStamp &stamp) {
+    std::unique_lock<std::mutex> guard(lock);
+    ready.wait(guard, [&] { return count > 0 || finished; });
+    if (count == 0) return false;
+
+    if (policy == CAPTURE_LATEST_FRAME && count > 1) {
+        head = (head + count - 1) % ring.size();
+        droppedCount += (long)(count - 1);
+        count = 1;
+    }
+    cv::swap(frame, ring[head]);
+    stamp = stamps[head];
+    head = (head + 1) % ring.size();
+    count--;
+    space.notify_one();
+    guard.unlock();
+
+    if (std::chrono::steady_clock::now() - stamp.captured > lateLimit) lateCount++;
+    return true;
+}
+
+void ThreadedCapture::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        ready.notify_all();
+        space.notify_all();
+    }
+    if (decoder.joinable()) decoder.join();
+    cap.release();
+}
+
+size_t ThreadedCapture::queued() {
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+}
@@ -0,0 +1,91 @@
+#ifndef THREADED_CAPTURE_H
+#define THREADED_CAPTURE_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decodes a video source on its own thread into a small ring of frame
+// buffers, so decoding overlaps with inference instead of adding to it.
+// Buffers are swapped in and out of the ring, never copied, and are reused
+// once their sizes settle.
+//
+// CAPTURE_EVERY_FRAME hands out every frame in order; the decoder waits
+// when the ring is full. Use it for files. CAPTURE_LATEST_FRAME never makes
+// the decoder wait: a full ring drops its oldest frame, and read() returns
+// only the newest frame and drops older ones. Use it for cameras and
+// streams, where falling behind real time is worse than skipping frames.
+//
+// Live sources are reopened with backoff when they stop delivering frames.
+// A file ends after a run of failed reads, like frame_drop_limit did.
+enum CapturePolicy {
+    CAPTURE_EVERY_FRAME,
+    CAPTURE_LATEST_FRAME
+};
+
+// Cameras (/dev/videoN or an index) and rtsp:// streams.
+bool isLiveSource(const std::string&);
+
+struct FrameStamp {
+    FrameStamp() : index(0) {}
+
+    long index;                                         // position in the source, counting dropped frames
+    std::chrono::steady_clock::time_point captured;     // when the decoder grabbed it
+};
+
+class ThreadedCapture {
+public:
+    ThreadedCapture(const std::string &source, CapturePolicy policy, size_t depth = 3);
+    ~ThreadedCapture();
+
+    // Opens the source and starts the decoder thread.
+    bool open();
+
+    // Blocks until a frame is ready and swaps it into `frame`; false once
+    // the source has ended (or stop() was called) and the ring is empty.
+    bool read(cv::Mat &frame);
+    bool read(cv::Mat &frame, FrameStamp &stamp);
+
+    void stop();
+
+    // Frame rate reported by the source when it was opened; 0 if unknown.
+    double sourceFps() const { return fps; }
+
+    long captured() const { return capturedCount.load(); }
+    long dropped() const { return droppedCount.load(); }
+    long late() const { return lateCount.load(); }     // older than two frame intervals when read
+    long reconnects() const { return reconnectCount.load(); }
+
+    // Frames decoded but not read yet.
+    size_t queued();
+
+private:
+    bool connect();
+    void run();
+
+    std::string source;
+    CapturePolicy policy;
+    bool live;
+    cv::VideoCapture cap;   // only touched by the decoder thread once started
+    double fps;
+    std::chrono::microseconds lateLimit;
+
+    std::mutex lock;
+    std::condition_variable ready;      // a frame was queued or the source ended
+    std::condition_variable space;      // a slot was freed, or stop() was called
+    std::vector<cv::Mat> ring;
+    std::vector<FrameStamp> stamps;
+    size_t head, count;
+    bool finished, stopping;
+    std::thread decoder;
+
+    std::atomic<long> capturedCount, droppedCount, lateCount, reconnectCount;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "tracker.h"
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+// Corners seeded per box, and the smallest box worth seeding.
+const int MAX_CORNERS = 12;
+const int MIN_SEED_AREA = 64;
+
+// A face is never carried over with fewer corners than this fraction of
+// its seeds: an unblurred face is worse than an extra forward pass.
+const float MIN_FACE_CONFIDENCE = 0.5f;
+const float MIN_PERSON_CONFIDENCE = 0.25f;
+
+// Tracked faces are blurred with this much extra margin on every side,
+// as a fraction of the box size, to absorb tracking error.
+const float FACE_MARGIN = 0.15f;
+
+// Mean absolute difference (gray levels) between thumbnails of the
+// keyframe and the current frame above which the scene is re-detected,
+// so people walking in between keyframes are not missed for long.
+const double SCENE_CHANGE_LIMIT = 10.0;
+const cv::Size THUMB_SIZE(80, 60);
+
+// Scheduler thresholds.
+const float CALM_CONFIDENCE = 0.8f;
+const float FAST_MOTION = 8.f;
+
+static float median(std::vector<float> &values) {
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+void DetectionTracker::seed(const cv::Mat &gray, const cv::Rect &box) {
+    Track track;
+    track.keyBox = box;
+    track.seeds = 0;
+    track.shift = cv::Point2f(0.f, 0.f);
+
+    cv::Rect roi = box & cv::Rect(0, 0, gray.cols, gray.rows);
+    if (roi.area() >= MIN_SEED_AREA) {
+        int minDistance = std::max(2, std::min(roi.width, roi.height) / 6);
+        cv::goodFeaturesToTrack(gray(roi), corners, MAX_CORNERS, 0.01, minDistance);
+
+        // Flat boxes get a coarse grid instead; those points track poorly,
+        // so confidence drops quickly and the box is re-detected.
+        if (corners.size() < 4) {
+            corners.clear();
+            for (int gy = 1; gy <= 3; ++gy) {
+                for (int gx = 1; gx <= 3; ++gx) {
+                    corners.push_back(cv::Point2f(roi.width * gx / 4.f, roi.height * gy / 4.f));
+                }
+            }
+        }
+        for (size_t i = 0; i < corners.size(); ++i) {
+            cv::Point2f p(corners[i].x + roi.x, corners[i].y + roi.y);
+            points.push_back(p);
+            origins.push_back(p);
+        }
+        track.seeds = (int)corners.size();
+    }
+    track.count = track.seeds;
+    tracks.push_back(track);
+}
+
+void DetectionTracker::reset(const cv::Mat &gray, const DecodedBoxes &people, const DecodedBoxes &faces) {
+    gray.copyTo(previous);
+    cv::resize(gray, keyframeThumb, THUMB_SIZE, 0, 0, cv::INTER_AREA);
+
+    trackedPeople = people;
+    trackedFaces = faces;
+    tracks.clear();
+    points.clear();
+    origins.clear();
+    numPeople = people.size();
+
+    for (size_t i = 0; i < people.size(); ++i) seed(gray, people.boxes[i]);
+    for (size_t i = 0; i < faces.size(); ++i) seed(gray, faces.boxes[i]);
+
+    lastConfidence = 1.f;
+    lastMotion = 0.f;
+}
+
+bool DetectionTracker::update(const cv::Mat &gray) {
+    cv::resize(gray, thumb, THUMB_SIZE, 0, 0, cv::INTER_AREA);
+    cv::absdiff(thumb, keyframeThumb, thumbDiff);
+    if (cv::mean(thumbDiff)[0] > SCENE_CHANGE_LIMIT) return false;
+
+    if (!points.empty()) {
+        cv::calcOpticalFlowPyrLK(previous, gray, points, nextPoints, status, errors, cv::Size(15, 15), 2);
+    }
+    gray.copyTo(previous);
+
+    lastConfidence = 1.f;
+    lastMotion = 0.f;
+    const cv::Rect frameRect(0, 0, gray.cols, gray.rows);
+    size_t read = 0, write = 0, kept = 0, keptPeople = 0;
+
+    // Moves each box and compacts the corners, tracks and people that
+    // survive; lost faces end the update instead.
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        Track track = tracks[t];
+        size_t end = read + track.count;
+        size_t first = write;
+
+        dx.clear();
+        dy.clear();
+        for (; read < end; ++read) {
+            if (!status[read] || !frameRect.contains(cv::Point(nextPoints[read]))) continue;
+            dx.push_back(nextPoints[read].x - origins[read].x);
+            dy.push_back(nextPoints[read].y - origins[read].y);
+            points[write] = nextPoints[read];
+            origins[write] = origins[read];
+            ++write;
+        }
+        track.count = (int)(write - first);
+        float confidence = track.seeds > 0 ? (float)track.count / track.seeds : 0.f;
+
+        cv::Rect box = track.keyBox;
+        if (track.count > 0) {
+            cv::Point2f shift(median(dx), median(dy));
+            lastMotion = std::max(lastMotion, (float)cv::norm(shift - track.shift));
+            track.shift = shift;
+            box.x += cvRound(shift.x);
+            box.y += cvRound(shift.y);
+        }
+
+        if (t >= numPeople) {
+            if (confidence < MIN_FACE_CONFIDENCE) return false;
+            int mx = cvRound(box.width * FACE_MARGIN), my = cvRound(box.height * FACE_MARGIN);
+            box = cv::Rect(box.x - mx, box.y - my, box.width + 2 * mx, box.height + 2 * my) & frameRect;
+            trackedFaces.boxes[t - numPeople] = box;
+        } else {
+            if (confidence < MIN_PERSON_CONFIDENCE || (box & frameRect).area() == 0) {
+                write = first;
+                continue;
+            }
+            trackedPeople.boxes[keptPeople] = box;
+            trackedPeople.classIds[keptPeople] = trackedPeople.classIds[t];
+            trackedPeople.confidences[keptPeople] = trackedPeople.confidences[t];
+            ++keptPeople;
+        }
+        lastConfidence = std::min(lastConfidence, confidence);
+        tracks[kept++] = track;
+    }
+
+    points.resize(write);
+    origins.resize(write);
+    tracks.resize(kept);
+    trackedPeople.boxes.resize(keptPeople);
+    trackedPeople.classIds.resize(keptPeople);
+    trackedPeople.confidences.resize(keptPeople);
+    numPeople = keptPeople;
+    return true;
+}
+
+void KeyframeScheduler::keyframe(bool forced) {
+    if (forced) {
+        interval = std::max(minInterval, interval / 2);
+    } else if (calm) {
+        interval = std::min(maxInterval, interval + 1);
+    }
+    calm = true;
+    sinceKeyframe = 0;
+    ++frames;
+    ++keyframes;
+}
+
+void KeyframeScheduler::tracked(float confidence, float motion) {
+    ++sinceKeyframe;
+    ++frames;
+    if (confidence < CALM_CONFIDENCE || motion > FAST_MOTION) {
+        if (calm) interval = std::max(minInterval, interval / 2);
+        calm = false;
+    }
+}
+
+double KeyframeScheduler::takeKeyframeRatio() {
+    double ratio = frames > 0 ? (double)keyframes / frames : 1.0;
+    frames = 0;
+    keyframes = 0;
+    return ratio;
+}
@@ -0,0 +1,93 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "yolo_decoder.h"
+
+// Carries detections from a keyframe to the following frames with sparse
+// Lucas-Kanade flow, so the networks do not have to run on every frame.
+// Each box is seeded with corners found inside it and moved by the median
+// displacement of the corners that were tracked successfully.
+class DetectionTracker {
+public:
+    DetectionTracker() : numPeople(0), lastConfidence(1.f), lastMotion(0.f) {}
+
+    // Starts tracking the detections of a keyframe. `gray` is that frame.
+    void reset(const cv::Mat &gray, const DecodedBoxes &people, const DecodedBoxes &faces);
+
+    // Moves every box to `gray`, the next frame. Returns false when a face
+    // could not be followed or the scene changed too much since the
+    // keyframe; the caller must then run detection on this frame.
+    bool update(const cv::Mat &gray);
+
+    const DecodedBoxes &people() const { return trackedPeople; }
+
+    const DecodedBoxes &faces() const { return trackedFaces; }
+
+    // Lowest fraction of corners still tracked in any box, after update().
+    float confidence() const { return lastConfidence; }
+
+    // Largest per-box displacement of the last update, in pixels.
+    float motion() const { return lastMotion; }
+
+private:
+    // A box as seen on the keyframe and how its corners have moved since.
+    struct Track {
+        cv::Rect keyBox;
+        int seeds;          // corners found on the keyframe
+        int count;          // corners still tracked
+        cv::Point2f shift;  // median corner displacement since the keyframe
+    };
+
+    void seed(const cv::Mat &gray, const cv::Rect &box);
+
+    cv::Mat previous;
+    cv::Mat keyframeThumb, thumb, thumbDiff;
+    DecodedBoxes trackedPeople, trackedFaces;
+
+    // People first, then faces; the corners of each track are stored
+    // contiguously in the same order.
+    std::vector<Track> tracks;
+    size_t numPeople;
+    std::vector<cv::Point2f> points, origins, nextPoints, corners;
+    std::vector<unsigned char> status;
+    std::vector<float> errors;
+    std::vector<float> dx, dy;
+
+    float lastConfidence;
+    float lastMotion;
+};
+
+// Decides which frames run the networks. `interval` is the keyframe period
+// (1 runs detection on every frame). It grows by one after every calm
+// stretch of tracking and is halved as soon as tracking loses confidence,
+// boxes move quickly or the tracker gives up.
+struct KeyframeScheduler {
+    explicit KeyframeScheduler(int maxInterval = 8, int minInterval = 1)
+        : minInterval(minInterval), maxInterval(std::max(minInterval, maxInterval)), interval(minInterval),
+          sinceKeyframe(0), calm(true), frames(0), keyframes(0) {}
+
+    bool due() const { return sinceKeyframe + 1 >= interval; }
+
+    // Detection ran on this frame; `forced` when the tracker asked for it.
+    void keyframe(bool forced);
+
+    // The tracker carried the boxes over this frame.
+    void tracked(float confidence, float motion);
+
+    // Fraction of frames that ran the networks since the last call.
+    double takeKeyframeRatio();
+
+    int minInterval;
+    int maxInterval;
+    int interval;
+    int sinceKeyframe;
+    bool calm;
+    long frames;
+    long keyframes;
+};
+
+#endif
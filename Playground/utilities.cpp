@@ -1,24 +1,100 @@
 #include "utilities.h"
+#include "forward_worker.h"
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
 
-cv::dnn::Net faceNet = cv::dnn::readNet(face_cfg_file, face_weights_file);
-cv::dnn::Net personNet = cv::dnn::readNet(person_cfg_file,person_weights_file);
+// Empty until loadNetworks(); each program loads only the networks it uses.
+cv::dnn::Net faceNet;
+cv::dnn::Net personNet;
+
+// Filled by loadNetworks; getUnconnectedOutLayersNames builds a new vector
+// per call.
+static std::vector<cv::String> faceOutNames;
+static std::vector<cv::String> personOutNames;
+
+static std::string modelDirectory = ".";
+
+// Startup timing for reportFirstDetection.
+static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+static std::atomic<long> loadMicros(0);
+static std::atomic<long> warmUpMicros(0);
+
+// Served by programs that start a MetricsServer; see metrics.h. Forward
+// times include the warm-up runs.
+static const int personForwardSeconds = histogramMetric("detector_forward_seconds",
+    "Time spent in Net::forward, by network", latencyBuckets(), "network=\"person\"");
+static const int faceForwardSeconds = histogramMetric("detector_forward_seconds",
+    "Time spent in Net::forward, by network", latencyBuckets(), "network=\"face\"");
+static const int personDetections = counterMetric("detector_detections_total",
+    "Detections kept after NMS, by class", "class=\"person\"");
+static const int cyclistDetections = counterMetric("detector_detections_total",
+    "Detections kept after NMS, by class", "class=\"cyclist\"");
+static const int faceDetections = counterMetric("detector_detections_total",
+    "Detections kept after NMS, by class", "class=\"face\"");
+static const int facesBlurred = counterMetric("detector_faces_blurred_total",
+    "Face regions anonymized, including tracked and reused ones");
+
+static void countDetections(const std::vector<int> &classIds, bool faceProcess) {
+    if (faceProcess) {
+        metricAdd(faceDetections, (long)classIds.size());
+        return;
+    }
+    long cyclists = (long)std::count(classIds.begin(), classIds.end(), 1);
+    metricAdd(personDetections, (long)classIds.size() - cyclists);
+    metricAdd(cyclistDetections, cyclists);
+}
+
+static long microsSince(const std::chrono::steady_clock::time_point &start) {
+    return (long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
 
 void detectFaces(cv::Mat &blob, std::vector<cv::Mat> &outs) {
+    ScopedMetricTimer timer(faceForwardSeconds);
     faceNet.setInput(blob);
-    faceNet.forward(outs, faceNet.getUnconnectedOutLayersNames());
+    faceNet.forward(outs, faceOutNames);
 }
 
 void detectPeople(cv::Mat &blob, std::vector<cv::Mat> &outs) {
+    ScopedMetricTimer timer(personForwardSeconds);
     personNet.setInput(blob);
-    personNet.forward(outs, personNet.getUnconnectedOutLayersNames());
+    personNet.forward(outs, personOutNames);
 }
 
-void configNetwork(cv::dnn::Net &net){
+// Never destroyed: the worker blocks for the lifetime of the process.
+static ForwardWorker& faceWorker() {
+    static ForwardWorker* worker = new ForwardWorker([](cv::Mat &blob, std::vector<cv::Mat> &outs) {
+        detectFaces(blob, outs);
+    });
+    return *worker;
+}
+
+// Both forwards on the same blob; returns once both outputs are ready.
+// On CUDA they run concurrently, so a frame costs max(person, face) rather
+// than the sum. On the CPU backend they run one after the other: OpenCV
+// has a single worker pool per process, and with its default pthreads
+// backend a parallel_for_ started while the pool is busy runs serially on
+// the calling thread, so a concurrent face forward would be single-threaded.
+// Run in a row, each forward gets the whole pool.
+void detectPeopleAndFaces(cv::Mat &blob, std::vector<cv::Mat> &personOuts, std::vector<cv::Mat> &faceOuts) {
+    // The same test configNetwork uses to pick the backend.
+    static const bool concurrent = cuda::getCudaEnabledDeviceCount() > 0;
 
-    if(faceNet.empty() || personNet.empty()){
-    std::cerr << "Could not load the neural networks. \nMake sure that the config and the weights are stored in the same directory as the executable.\nThe names need to be faces.cfg, faces.weights, person.cfg, person.weights"<<std::endl;
-    exit(0);
+    if (concurrent) {
+        ForwardWorker &worker = faceWorker();
+        worker.start(blob, faceOuts);
+        detectPeople(blob, personOuts);
+        worker.wait();
+    } else {
+        detectPeople(blob, personOuts);
+        detectFaces(blob, faceOuts);
     }
+}
+
+void configNetwork(cv::dnn::Net &net){
+
     // Check if OpenCV is built with CUDA support and set CUDA as preferable backend and target
     if (cuda::getCudaEnabledDeviceCount() > 0) {
         net.setPreferableBackend(DNN_BACKEND_CUDA);
@@ -31,79 +107,396 @@ void configNetwork(cv::dnn::Net &net){
     }
 }
 
+void setModelDirectory(const std::string &directory) {
+    modelDirectory = directory.empty() ? "." : directory;
+}
+
+// Reads one network from the model directory and checks that it parsed
+// into something with output layers; `error` says what went wrong.
+static bool readDetector(const std::string &cfgFile, const std::string &weightsFile, cv::dnn::Net &net,
+                         std::vector<cv::String> &outNames, std::string &error) {
+    std::string cfg = modelDirectory + "/" + cfgFile, weights = modelDirectory + "/" + weightsFile;
+    if (!std::ifstream(cfg.c_str()).good()) {
+        error = "cannot read " + cfg;
+        return false;
+    }
+    if (!std::ifstream(weights.c_str()).good()) {
+        error = "cannot read " + weights;
+        return false;
+    }
+
+    try {
+        net = cv::dnn::readNet(cfg, weights);
+    } catch (const cv::Exception &e) {
+        error = cfg + ": " + e.what();
+        return false;
+    }
+    if (net.empty()) {
+        error = cfg + " has no layers";
+        return false;
+    }
+    outNames = net.getUnconnectedOutLayersNames();
+    if (outNames.empty()) {
+        error = cfg + " has no output layers";
+        return false;
+    }
+    return true;
+}
+
+// Reads the requested networks, the two in parallel, then sets their
+// backend. Nothing is configured unless every requested network loaded.
+static bool loadPair(bool person, bool face, cv::dnn::Net &personOut, std::vector<cv::String> &personNames,
+                     cv::dnn::Net &faceOut, std::vector<cv::String> &faceNames) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string personError, faceError;
+    bool personLoaded = true, faceLoaded = true;
+
+    std::thread personReader;
+    if (person && face) {
+        personReader = std::thread([&] {
+            personLoaded = readDetector(person_cfg_file, person_weights_file, personOut, personNames, personError);
+        });
+    } else if (person) {
+        personLoaded = readDetector(person_cfg_file, person_weights_file, personOut, personNames, personError);
+    }
+    if (face) faceLoaded = readDetector(face_cfg_file, face_weights_file, faceOut, faceNames, faceError);
+    if (personReader.joinable()) personReader.join();
+
+    if (!personLoaded) std::cerr << "Could not load the person network: " << personError << std::endl;
+    if (!faceLoaded) std::cerr << "Could not load the face network: " << faceError << std::endl;
+    if (!personLoaded || !faceLoaded) {
+        std::cerr << "The files must be named " << person_cfg_file << ", " << person_weights_file << ", "
+                  << face_cfg_file << " and " << face_weights_file << " in " << modelDirectory
+                  << " (see --models)" << std::endl;
+        return false;
+    }
+
+    if (person) configNetwork(personOut);
+    if (face) configNetwork(faceOut);
+    loadMicros = microsSince(start);
+    return true;
+}
+
+// Loads the shared networks the caller needs, replacing whatever was
+// loaded before.
+bool loadNetworks(bool person, bool face) {
+    return loadPair(person, face, personNet, personOutNames, faceNet, faceOutNames);
+}
+
+// Reads the requested networks into `nets`. Returns false when a file set
+// is missing or does not parse.
+bool loadDetectorNets(DetectorNets &nets, bool person, bool face) {
+    return loadPair(person, face, nets.person, nets.personOutNames, nets.face, nets.faceOutNames);
+}
+
+// Gray network-sized input for warm-up passes.
+static void warmUpBlob(cv::Mat &blob) {
+    cv::Mat gray(NETWORK_HEIGHT, NETWORK_WIDTH, CV_8UC3, cv::Scalar::all(128));
+    blobFromImage(gray, blob, 1/255.0, Size(NETWORK_WIDTH, NETWORK_HEIGHT), Scalar(0, 0, 0), true, false);
+}
+
+// The first forward allocates every layer's buffers and, on CUDA, picks
+// the kernels; running it before the first frame keeps that out of the
+// frame loop. When both networks are loaded they are warmed up together
+// through detectPeopleAndFaces, which on CUDA also starts its face thread.
+void warmUpNetworks(int runs) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    cv::Mat blob;
+    std::vector<cv::Mat> personOuts, faceOuts;
+    warmUpBlob(blob);
+
+    for (int i = 0; i < runs; ++i) {
+        if (!personNet.empty() && !faceNet.empty()) {
+            detectPeopleAndFaces(blob, personOuts, faceOuts);
+        } else if (!personNet.empty()) {
+            detectPeople(blob, personOuts);
+        } else if (!faceNet.empty()) {
+            detectFaces(blob, faceOuts);
+        }
+    }
+    warmUpMicros = microsSince(start);
+}
+
+void warmUpDetectorNets(DetectorNets &nets, int runs) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    cv::Mat blob;
+    std::vector<cv::Mat> outs;
+    warmUpBlob(blob);
+
+    for (int i = 0; i < runs; ++i) {
+        if (!nets.person.empty()) detectPeople(nets, blob, outs);
+        if (!nets.face.empty()) detectFaces(nets, blob, outs);
+    }
+    warmUpMicros = microsSince(start);
+}
+
+// Prints, once per process, how long after start the first frame was
+// through detection and how much of that went to loading and warm-up.
+void reportFirstDetection() {
+    static std::atomic<bool> reported(false);
+    if (reported.exchange(true)) return;
+
+    std::cerr << format("Time to first detection: %.0f ms (networks loaded in %.0f ms, warm-up %.0f ms)",
+                        microsSince(processStart) / 1000.0, loadMicros.load() / 1000.0, warmUpMicros.load() / 1000.0)
+              << std::endl;
+}
+
+void detectPeople(DetectorNets &nets, cv::Mat &blob, std::vector<cv::Mat> &outs) {
+    ScopedMetricTimer timer(personForwardSeconds);
+    nets.person.setInput(blob);
+    nets.person.forward(outs, nets.personOutNames);
+}
+
+void detectFaces(DetectorNets &nets, cv::Mat &blob, std::vector<cv::Mat> &outs) {
+    ScopedMetricTimer timer(faceForwardSeconds);
+    nets.face.setInput(blob);
+    nets.face.forward(outs, nets.faceOutNames);
+}
+
 void getBoxes(const std::vector<cv::Mat>&outs, std::vector<cv::Rect> &boxes, const cv::Mat &frame,std::vector<int> &classIds,std::vector<float> &confidences) {
+    getBoxes(outs, boxes, cv::Rect(0, 0, frame.cols, frame.rows), classIds, confidences);
+}
+
+// Same as above, but the network input covered only `region` of the frame,
+// so normalized coordinates are mapped into that rectangle.
+void getBoxes(const std::vector<cv::Mat>&outs, std::vector<cv::Rect> &boxes, const cv::Rect &region,std::vector<int> &classIds,std::vector<float> &confidences) {
+    // Person (0) and cyclist (1); the face model only has class 0.
+    decodeYolo(outs, region, CONFIDENCE_THRESHOLD, 2, boxes, classIds, confidences);
+}
 
+// Rows of a batched forward output that belong to image `index` of `batchSize`.
+void batchSlice(const std::vector<cv::Mat> &outs, int batchSize, int index, std::vector<cv::Mat> &slice) {
+    slice.resize(outs.size());
     for (size_t i = 0; i < outs.size(); ++i) {
-        float* data = (float*)outs[i].data;
-        for (int j = 0; j < outs[i].rows; ++j, data += outs[i].cols) {
-            cv::Mat scores = outs[i].row(j).colRange(5, outs[i].cols);
-            cv::Point classIdPoint;
-            double confidence;
-            cv::minMaxLoc(scores, nullptr, &confidence, nullptr, &classIdPoint);
-            if (confidence > CONFIDENCE_THRESHOLD && classIdPoint.x < 2){
-                int centerX = (int)(data[0] * frame.cols);
-                int centerY = (int)(data[1] * frame.rows);
-                int width = (int)(data[2] * frame.cols);
-                int height = (int)(data[3] * frame.rows);
-                int left = centerX - width / 2;
-                int top = centerY - height / 2;
-
-                classIds.push_back(classIdPoint.x);
-                confidences.push_back((float)confidence);
-                boxes.push_back(Rect(left, top, width, height));
-            }
-        }
+        int rows = outs[i].rows / batchSize;
+        slice[i] = outs[i].rowRange(index * rows, (index + 1) * rows);
     }
+}
+
+// Class-aware NMS over ctx.candidates; the survivors are appended to `kept`.
+static void suppressCandidates(float confidenceThreshold, bool faceProcess, FrameContext &ctx, DecodedBoxes &kept) {
+    // Per class, so an overlapping person and cyclist both survive.
+    classAwareNMS(ctx.candidates.boxes, ctx.candidates.confidences, ctx.candidates.classIds,
+                  NmsParams(confidenceThreshold, NMS_THRESHOLD), ctx.nms, ctx.indices);
 
+    for (int idx : ctx.indices) {
+        kept.boxes.push_back(ctx.candidates.boxes[idx]);
+        kept.classIds.push_back(ctx.candidates.classIds[idx]);
+        kept.confidences.push_back(ctx.candidates.confidences[idx]);
+    }
+    countDetections(kept.classIds, faceProcess);
+    ctx.noteHighWater();
 }
 
-void postProcess(cv::Mat &frame, const std::vector<cv::Mat> &outs,bool faceProcess = false, bool driverView = false) {
+// Decodes into ctx.candidates, suppresses with the context's NMS scratch
+// and leaves the survivors in `kept`; allocation-free once the context has
+// seen a few frames.
+void getDetections(const std::vector<cv::Mat> &outs, const cv::Rect &region, bool faceProcess, FrameContext &ctx, DecodedBoxes &kept) {
 
     float confidence_threshold = faceProcess? FACE_CONFIDENCE_THRESHOLD : CONFIDENCE_THRESHOLD;
 
-    std::vector<int> classIds;
-    int classId;
-    double confidence;
-    std::vector<float> confidences;
-    std::vector<cv::Rect> boxes;
-    std::vector<int> indices;
-    cv::Rect box;
+    ctx.candidates.clear();
+    kept.clear();
+    getBoxes(outs, ctx.candidates.boxes, region, ctx.candidates.classIds, ctx.candidates.confidences);
 
-    getBoxes(outs, boxes, frame, classIds, confidences);
+    suppressCandidates(confidence_threshold, faceProcess, ctx, kept);
+}
+
+// Splits a frame of `size` into cols x rows tiles that overlap their
+// neighbours by `overlap` (a fraction of the tile size). A count of 0 picks
+// enough tiles of roughly network size to cover that dimension.
+void tileFrame(const cv::Size &size, int cols, int rows, float overlap, std::vector<cv::Rect> &tiles) {
+    overlap = std::min(std::max(overlap, 0.f), 0.9f);
+    if (cols <= 0) cols = std::max(1, (int)std::ceil((size.width - overlap * NETWORK_WIDTH) / (NETWORK_WIDTH * (1 - overlap))));
+    if (rows <= 0) rows = std::max(1, (int)std::ceil((size.height - overlap * NETWORK_HEIGHT) / (NETWORK_HEIGHT * (1 - overlap))));
 
-    NMSBoxes(boxes, confidences, confidence_threshold,NMS_THRESHOLD,indices);
+    // Tile size such that `cols` tiles with the given overlap span the width.
+    double tileWidth = size.width / (cols - (cols - 1) * overlap);
+    double tileHeight = size.height / (rows - (rows - 1) * overlap);
 
-    for(int idx : indices){
-        box = boxes[idx];
-        if(faceProcess){
-            blurFaces(box, frame);
+    tiles.clear();
+    for (int r = 0; r < rows; ++r) {
+        int top = cvRound(r * tileHeight * (1 - overlap));
+        int bottom = r == rows - 1 ? size.height : cvRound(r * tileHeight * (1 - overlap) + tileHeight);
+        for (int c = 0; c < cols; ++c) {
+            int left = cvRound(c * tileWidth * (1 - overlap));
+            int right = c == cols - 1 ? size.width : cvRound(c * tileWidth * (1 - overlap) + tileWidth);
+            tiles.push_back(cv::Rect(left, top, right - left, bottom - top));
         }
-        else{
-            classId = classIds[idx];
-            confidence = confidences[idx];
-            annotate(classId,confidence, box,frame, driverView);
+    }
+}
+
+// Decodes a batched forward over `tiles` (one image per tile, in order)
+// into frame coordinates and suppresses across all tiles at once, so a
+// person on a tile border is only kept once.
+void getTiledDetections(const std::vector<cv::Mat> &outs, const std::vector<cv::Rect> &tiles, bool faceProcess, FrameContext &ctx, DecodedBoxes &kept) {
+
+    float confidence_threshold = faceProcess? FACE_CONFIDENCE_THRESHOLD : CONFIDENCE_THRESHOLD;
+
+    ctx.candidates.clear();
+    kept.clear();
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        batchSlice(outs, (int)tiles.size(), (int)i, ctx.tileOuts);
+        getBoxes(ctx.tileOuts, ctx.candidates.boxes, tiles[i], ctx.candidates.classIds, ctx.candidates.confidences);
+    }
+
+    suppressCandidates(confidence_threshold, faceProcess, ctx, kept);
+}
+
+void drawDetections(cv::Mat &frame, DecodedBoxes &detections, bool faceProcess, bool driverView) {
+    drawDetections(frame, detections.boxes, detections.classIds, detections.confidences, faceProcess, driverView);
+}
+
+void drawDetections(cv::Mat &frame, std::vector<cv::Rect> &boxes, const std::vector<int> &classIds, const std::vector<float> &confidences, bool faceProcess, bool driverView) {
+    if (faceProcess) {
+        // Outlines first, then all faces at once so they can run in parallel.
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            cv::rectangle(frame, boxes[i].tl(), boxes[i].br(), Scalar(0,255,0),3);
         }
-    } 
+        anonymizeRegions(frame, boxes, faceAnonymizer());
+        metricAdd(facesBlurred, (long)boxes.size());
+        return;
+    }
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        annotate(classIds[i], confidences[i], boxes[i], frame, driverView);
+    }
+}
+
+void postProcess(cv::Mat &frame, const std::vector<cv::Mat> &outs, bool faceProcess, bool driverView, FrameContext &ctx) {
+
+    DecodedBoxes &kept = faceProcess ? ctx.faces : ctx.people;
+
+    getDetections(outs, cv::Rect(0, 0, frame.cols, frame.rows), faceProcess, ctx, kept);
+
+    drawDetections(frame, kept, faceProcess, driverView);
+}
+
+// Square region over the top of a person box where the head should be.
+cv::Rect headRegion(const cv::Rect &person, const cv::Size &bounds) {
+    int side = std::max(person.width, person.height / 3);
+    int centerX = person.x + person.width / 2;
+    cv::Rect head(centerX - side / 2, person.y - side / 8, side, side);
+    return head & cv::Rect(0, 0, bounds.width, bounds.height);
+}
+
+// Cascade face detection: the face net only sees the head region of each
+// person, cropped from `source` (the full-resolution capture) and run as a
+// single NCHW batch. `people` and the returned faces are in `frame`
+// coordinates; nothing is run when there are no people.
+void detectFacesInPeople(const cv::Mat &source, const cv::Mat &frame, const std::vector<cv::Rect> &people, std::vector<cv::Rect> &faces, std::vector<float> &confidences) {
+
+    faces.clear();
+    confidences.clear();
+    if (people.empty()) return;
+
+    double scaleX = (double)source.cols / frame.cols;
+    double scaleY = (double)source.rows / frame.rows;
+    std::vector<cv::Mat> crops;
+    std::vector<cv::Rect> regions;
+
+    for (size_t i = 0; i < people.size(); ++i) {
+        cv::Rect person((int)(people[i].x * scaleX), (int)(people[i].y * scaleY),
+                        (int)(people[i].width * scaleX), (int)(people[i].height * scaleY));
+        cv::Rect head = headRegion(person, source.size());
+        if (head.area() == 0) continue;
+        crops.push_back(source(head));
+        regions.push_back(head);
+    }
+    if (crops.empty()) return;
+
+    cv::Mat blob;
+    std::vector<cv::Mat> outs, slice;
+    std::vector<cv::Rect> boxes;
+    std::vector<int> classIds, indices;
+    std::vector<float> scores;
+
+    blobFromImages(crops, blob, 1/255.0, Size(CASCADE_FACE_SIZE, CASCADE_FACE_SIZE), Scalar(0, 0, 0), true, false);
+    detectFaces(blob, outs);
+
+    for (size_t i = 0; i < regions.size(); ++i) {
+        batchSlice(outs, (int)regions.size(), (int)i, slice);
+        getBoxes(slice, boxes, regions[i], classIds, scores);
+    }
+
+    // Neighbouring head regions overlap, so suppress across all crops.
+    fastNMSBoxes(boxes, scores, FACE_CONFIDENCE_THRESHOLD, NMS_THRESHOLD, indices);
+    for (int idx : indices) {
+        const cv::Rect &box = boxes[idx];
+        faces.push_back(cv::Rect((int)(box.x / scaleX), (int)(box.y / scaleY),
+                                 (int)(box.width / scaleX), (int)(box.height / scaleY)));
+        confidences.push_back(scores[idx]);
+    }
+    metricAdd(faceDetections, (long)faces.size());
+}
+
+// Blacks out everything outside the driver's field of view and draws its
+// outline on `frame`.
+void maskFrame(Mat& frame, Mat& maskedFrame){
+    FovMask fov;
+    maskFrame(frame, maskedFrame, fov);
+}
+
+// Rebuilds `fov` only when the frame size changes.
+void updateFovMask(const cv::Size &size, FovMask &fov) {
+    if (fov.size == size && !fov.mask.empty()) return;
+
+    int frameWidth = size.width;
+    int frameHeight = size.height;
+
+    // Calculate points for the field of view
+    fov.polygon[0] = cv::Point(frameWidth / 4, frameHeight);
+    fov.polygon[1] = cv::Point(3 * frameWidth / 4 , frameHeight);
+    fov.polygon[2] = cv::Point(9 * frameWidth / 10, frameHeight / 2);
+    fov.polygon[3] = cv::Point(frameWidth / 10 , frameHeight / 2);
+
+    fov.mask = cv::Mat::zeros(size, CV_8UC1);
+    cv::fillConvexPoly(fov.mask, fov.polygon, 4, cv::Scalar(255));
+
+    fov.bounds = cv::boundingRect(std::vector<cv::Point>(fov.polygon, fov.polygon + 4)) & cv::Rect(cv::Point(0, 0), size);
+    fov.size = size;
+}
+
+// Same, with the mask cached in `fov`. `maskedFrame` is only cleared when
+// it is (re)allocated; afterwards only the polygon's bounding rectangle is
+// copied, since everything outside it stays black.
+void maskFrame(Mat& frame, Mat& maskedFrame, FovMask& fov){
+    bool resized = fov.size != frame.size();
+    updateFovMask(frame.size(), fov);
+
+    // Draw lines to represent the field of view
+    const cv::Point *polygon = fov.polygon;
+    cv::line(frame, polygon[0], polygon[3], cv::Scalar(0, 255, 0), 2, cv::LINE_AA);
+    cv::line(frame, polygon[1], polygon[2], cv::Scalar(0, 255, 0), 2, cv::LINE_AA);
+    cv::line(frame, polygon[3], polygon[2], cv::Scalar(0, 255, 0), 2, cv::LINE_AA);
+
+    if (resized || maskedFrame.size() != frame.size() || maskedFrame.type() != frame.type()) {
+        maskedFrame.create(frame.size(), frame.type());
+        maskedFrame.setTo(cv::Scalar::all(0));
+    }
+
+    // Apply the mask to the frame
+    frame(fov.bounds).copyTo(maskedFrame(fov.bounds), fov.mask(fov.bounds));
 }
 
+// Outlines the face and anonymizes it with the method chosen through
+// setFaceAnonymizer; faces on the border are clipped, not skipped.
 void blurFaces(cv::Rect &box, cv::Mat& frame){
     int left = box.x, top = box.y, right = box.x + box.width, bottom = box.y + box.height;
 
     cv::rectangle(frame, cv::Point(left,top),cv::Point(right,bottom), Scalar(0,255,0),3);
-    if(left >= 0 && top >= 0 && right <= frame.cols && bottom <= frame.rows) {
-        cv::Mat roi = frame(box);
-        cv::GaussianBlur(roi, roi, cv::Size(31,31),13.0,13.0);
-        roi.copyTo(frame(box));
-    }
+    anonymizeRegion(frame, box, faceAnonymizer());
+    metricAdd(facesBlurred);
 }
 
 void annotate(int classId, float confidence,cv::Rect &box, cv::Mat& frame, bool driverView) {
     int left = box.x, top = box.y, right = box.x + box.width, bottom = box.y + box.height;
 
     cv::rectangle(frame, cv::Point(left,top),cv::Point(right,bottom), Scalar(0,255,0),3);
-    std::string label = format("%.2f", confidence);
-    std::string classP = classId? "Cyclist" : "Person";
-    label = classP + ": " + label;
+    // Reused per thread; short labels fit the string's inline buffer anyway.
+    static thread_local std::string label;
+    char text[32];
+    snprintf(text, sizeof(text), "%s: %.2f", classId? "Cyclist" : "Person", confidence);
+    label.assign(text);
     cv::putText(frame, label, Point(left, top - 5), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0), 2);
     if(driverView) {
         putText(frame, "Slow Down!", Point(frame.cols / 3, 50), FONT_HERSHEY_SIMPLEX, 2, Scalar(0,0,255),4);
@@ -113,4 +506,32 @@ void annotate(int classId, float confidence,cv::Rect &box, cv::Mat& frame, bool
     }
     
 
-}
\ No newline at end of file
+}
+
+bool hasFlag(int argc, char** argv, const std::string &flag) {
+    for (int i = 1; i < argc; ++i) {
+        if (flag == argv[i]) return true;
+    }
+    return false;
+}
+
+int intOption(int argc, char** argv, const std::string &name, int defaultValue) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (name == argv[i]) return atoi(argv[i + 1]);
+    }
+    return defaultValue;
+}
+
+double doubleOption(int argc, char** argv, const std::string &name, double defaultValue) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (name == argv[i]) return atof(argv[i + 1]);
+    }
+    return defaultValue;
+}
+
+std::string stringOption(int argc, char** argv, const std::string &name, const std::string &defaultValue) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (name == argv[i]) return argv[i + 1];
+    }
+    return defaultValue;
+}
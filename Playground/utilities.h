@@ -8,6 +8,13 @@
 #include <opencv2/dnn.hpp>
 #include <opencv2/core/cuda.hpp>
 #include <iostream>
+#include <thread>
+
+#include "anonymize.h"
+#include "frame_context.h"
+#include "nms.h"
+#include "precision.h"
+#include "yolo_decoder.h"
 
 using namespace cv;
 using namespace std;
@@ -20,26 +27,89 @@ const float NMS_THRESHOLD = 0.3;
 const int NETWORK_HEIGHT = 416;
 const int NETWORK_WIDTH = 416;
 
+// Face-net input size for the head crops used in cascade mode.
+const int CASCADE_FACE_SIZE = 128;
+
 const std::string face_cfg_file = "faces.cfg";
 const std::string face_weights_file = "faces.weights";
 const std::string person_cfg_file = "person.cfg";
 const std::string person_weights_file = "person.weights";
 
+// Empty until loadNetworks().
 extern cv::dnn::Net faceNet;
 extern cv::dnn::Net personNet;
 
+// A private copy of the networks for one worker thread; cv::dnn::Net is
+// not safe to share between threads that call forward().
+struct DetectorNets {
+    cv::dnn::Net person;
+    cv::dnn::Net face;
+    std::vector<cv::String> personOutNames;
+    std::vector<cv::String> faceOutNames;
+};
+
 void configNetwork(cv::dnn::Net&);
 
-void postProcess(cv::Mat&, const std::vector<cv::Mat>&, bool,bool);
+void setModelDirectory(const std::string&);
+
+bool loadNetworks(bool, bool);
+
+bool loadDetectorNets(DetectorNets&, bool, bool);
+
+void warmUpNetworks(int);
+
+void warmUpDetectorNets(DetectorNets&, int);
+
+void reportFirstDetection();
+
+void detectPeople(DetectorNets&, cv::Mat&, std::vector<cv::Mat>&);
+
+void detectFaces(DetectorNets&, cv::Mat&, std::vector<cv::Mat>&);
+
+void postProcess(cv::Mat&, const std::vector<cv::Mat>&, bool, bool, FrameContext&);
 
 void getBoxes(const std::vector<cv::Mat>&, std::vector<cv::Rect>&, const cv::Mat&, std::vector<int> &, std::vector<float>&);
 
+void getBoxes(const std::vector<cv::Mat>&, std::vector<cv::Rect>&, const cv::Rect&, std::vector<int> &, std::vector<float>&);
+
+void batchSlice(const std::vector<cv::Mat>&, int, int, std::vector<cv::Mat>&);
+
+void getDetections(const std::vector<cv::Mat>&, const cv::Rect&, bool, FrameContext&, DecodedBoxes&);
+
+void tileFrame(const cv::Size&, int, int, float, std::vector<cv::Rect>&);
+
+void getTiledDetections(const std::vector<cv::Mat>&, const std::vector<cv::Rect>&, bool, FrameContext&, DecodedBoxes&);
+
+void drawDetections(cv::Mat&, std::vector<cv::Rect>&, const std::vector<int>&, const std::vector<float>&, bool, bool);
+
+void drawDetections(cv::Mat&, DecodedBoxes&, bool, bool);
+
+cv::Rect headRegion(const cv::Rect&, const cv::Size&);
+
+void detectFacesInPeople(const cv::Mat&, const cv::Mat&, const std::vector<cv::Rect>&, std::vector<cv::Rect>&, std::vector<float>&);
+
 void detectFaces(cv::Mat&, std::vector<cv::Mat>&);
 
+void maskFrame(cv::Mat&, cv::Mat&);
+
+void updateFovMask(const cv::Size&, FovMask&);
+
+void maskFrame(cv::Mat&, cv::Mat&, FovMask&);
+
 void blurFaces(cv::Rect&, cv::Mat&);
 
 void detectPeople(cv::Mat&, std::vector<cv::Mat>&);
 
+void detectPeopleAndFaces(cv::Mat&, std::vector<cv::Mat>&, std::vector<cv::Mat>&);
+
 void annotate(int, float, cv::Rect&, cv::Mat&, bool);
 
+bool hasFlag(int, char**, const std::string&);
+
+int intOption(int, char**, const std::string&, int);
+
+double doubleOption(int, char**, const std::string&, double);
+
+std::string stringOption(int, char**, const std::string&, const std::string&);
+
 #endif
\ No newline at end of file
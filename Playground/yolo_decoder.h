@@ -0,0 +1,115 @@
+#ifndef YOLO_DECODER_H
+#define YOLO_DECODER_H
+
+// Shared decoder for the region outputs of the darknet YOLO models. Each row
+// is [cx, cy, w, h, objectness, class scores...], with every class score
+// already multiplied by objectness, so no class can beat the threshold
+// when objectness does not. Rows are rejected on that test first, and the
+// class argmax only runs on the survivors.
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <vector>
+
+// Candidate boxes in structure-of-arrays form; reserve once and reuse.
+struct DecodedBoxes {
+    std::vector<cv::Rect> boxes;
+    std::vector<int> classIds;
+    std::vector<float> confidences;
+
+    void clear() {
+        boxes.clear();
+        classIds.clear();
+        confidences.clear();
+    }
+
+    void reserve(size_t n) {
+        boxes.reserve(n);
+        classIds.reserve(n);
+        confidences.reserve(n);
+    }
+
+    size_t size() const { return boxes.size(); }
+};
+
+// Index of the first maximum, matching what minMaxLoc reports. A NaN can
+// end up as the maximum and matches no score; the row is then reported as
+// class 0 with confidence 0 so that the caller drops it.
+inline int argmaxScores(const float* scores, int n, float &best) {
+    float m = scores[0];
+    int i = 1;
+#if CV_SIMD128
+    if (n >= 8) {
+        cv::v_float32x4 vmax = cv::v_load(scores);
+        for (i = 4; i + 4 <= n; i += 4) {
+            vmax = cv::v_max(vmax, cv::v_load(scores + i));
+        }
+        m = cv::v_reduce_max(vmax);
+    }
+#endif
+    for (; i < n; ++i) {
+        if (scores[i] > m) m = scores[i];
+    }
+    int id = 0;
+    while (id < n && scores[id] != m) ++id;
+    if (id == n) {
+        best = 0.f;
+        return 0;
+    }
+    best = m;
+    return id;
+}
+
+// NC is the class count of the model (80 for COCO, 1 for the face model) so
+// the score loop has a compile-time trip count; NC = 0 reads it from the
+// output width instead. Only classes below `acceptClasses` are kept, and
+// boxes are mapped into `region` of the frame.
+template <int NC>
+void decodeYoloOutput(const cv::Mat &out, const cv::Rect &region, float threshold, int acceptClasses,
+                      std::vector<cv::Rect> &boxes, std::vector<int> &classIds, std::vector<float> &confidences) {
+    const int numClasses = NC > 0 ? NC : out.cols - 5;
+    CV_Assert(out.cols == numClasses + 5 && numClasses > 0 && out.type() == CV_32F);
+
+    for (int j = 0; j < out.rows; ++j) {
+        const float* data = out.ptr<float>(j);
+        if (data[4] <= threshold) continue;
+
+        float confidence = data[5];
+        int classId = 0;
+        if (numClasses > 1) classId = argmaxScores(data + 5, numClasses, confidence);
+        if (confidence <= threshold || classId >= acceptClasses) continue;
+
+        int centerX = region.x + (int)(data[0] * region.width);
+        int centerY = region.y + (int)(data[1] * region.height);
+        int width = (int)(data[2] * region.width);
+        int height = (int)(data[3] * region.height);
+
+        classIds.push_back(classId);
+        confidences.push_back(confidence);
+        boxes.push_back(cv::Rect(centerX - width / 2, centerY - height / 2, width, height));
+    }
+}
+
+inline void decodeYolo(const std::vector<cv::Mat> &outs, const cv::Rect &region, float threshold, int acceptClasses,
+                       std::vector<cv::Rect> &boxes, std::vector<int> &classIds, std::vector<float> &confidences) {
+    for (size_t i = 0; i < outs.size(); ++i) {
+        switch (outs[i].cols) {
+        case 80 + 5:
+            decodeYoloOutput<80>(outs[i], region, threshold, acceptClasses, boxes, classIds, confidences);
+            break;
+        case 1 + 5:
+            decodeYoloOutput<1>(outs[i], region, threshold, acceptClasses, boxes, classIds, confidences);
+            break;
+        default:
+            decodeYoloOutput<0>(outs[i], region, threshold, acceptClasses, boxes, classIds, confidences);
+            break;
+        }
+    }
+}
+
+inline void decodeYolo(const std::vector<cv::Mat> &outs, const cv::Rect &region, float threshold, int acceptClasses,
+                       DecodedBoxes &result) {
+    decodeYolo(outs, region, threshold, acceptClasses, result.boxes, result.classIds, result.confidences);
+}
+
+#endif
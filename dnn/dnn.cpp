@@ -31,21 +31,14 @@ const int NETWORK_HEIGHT = 416;
 void Blur(int classId, float conf, int left, int top, int right, int bottom, Mat& frame) {
 
     rectangle(frame, Point(left, top), Point(right, bottom), Scalar(0, 255, 0), 3);
-    // Define the region of interest
-    cv::Rect roi(left, top, right - left + 1, bottom - top + 1);
+    // Define the region of interest, clipped so faces on the border are
+    // still blurred
+    cv::Rect roi = cv::Rect(left, top, right - left + 1, bottom - top + 1) & cv::Rect(0, 0, frame.cols, frame.rows);
 
-    // Check if the ROI is within the frame bounds
-    if (roi.x >= 0 && roi.y >= 0 && roi.width + roi.x <= frame.cols && roi.height + roi.y <= frame.rows) {
-        // Extract the ROI from the frame
+    if (!roi.empty()) {
+        // Blurred in place; the ROI shares the frame's pixels
         cv::Mat roiImg = frame(roi);
-
-        // Apply Gaussian blur to the extracted ROI
         cv::GaussianBlur(roiImg, roiImg, cv::Size(31, 31), 10.0, 10.0);
-    
-        // Copy the blurred ROI back to the original image
-        roiImg.copyTo(frame(roi));
-    } else {
-        std::cerr << "Error: ROI is out of bounds." << std::endl;
     }
     string label = format("%.2f", conf);
     label = "Face: " + label;
@@ -3,15 +3,43 @@
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include "detection_events.h"
+#include "nms.h"
+#include "yolo_decoder.h"
 
 using namespace std;
 using namespace cv;
 using namespace cv::dnn;
 
+void usage(const char* name) {
+    cerr << "Usage: " << name << " <cfg_file_path> <weights_path> <video_path> [--events PATH] [--events-format jsonl|binary]" << endl;
+    cerr << "  Detections are written to PATH (default: stdout, JSON lines)" << endl;
+}
+
 int main(int argc, char** argv) {
     
-    if (argc != 4) {
-        cerr << "Usage: " << argv[0] << " <cfg_file_path> <weights_path> <video_path>" << endl;
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Every option takes a value; anything else is rejected rather than
+    // shifting the pairs after it.
+    std::string eventsPath = "-", formatName = "jsonl";
+    for (int i = 4; i < argc; i += 2) {
+        std::string arg = argv[i];
+        bool known = arg == "--events" || arg == "--events-format";
+        if (!known || i + 1 >= argc) {
+            cerr << (known ? "Missing value for " : "Unknown option ") << arg << endl;
+            usage(argv[0]);
+            return 1;
+        }
+        if (arg == "--events") eventsPath = argv[i + 1];
+        else formatName = argv[i + 1];
+    }
+    EventFormat eventFormat;
+    if (!parseEventFormat(formatName, eventFormat)) {
+        cerr << "--events-format must be jsonl or binary" << endl;
         return 1;
     }
 
@@ -41,7 +69,16 @@ int main(int argc, char** argv) {
     std::string line;
     while (getline(ifs, line)) classes.push_back(line);
 
+    // Post-NMS detections go to a background writer; see detection_events.h.
+    DetectionEventSink events;
+    if (!events.open(eventsPath, eventFormat, classes)) {
+        std::cerr << "Could not open " << eventsPath << std::endl;
+        return 1;
+    }
+
     cv::Mat frame;
+    std::vector<int> indices;
+    int64_t frameId = 0;
     while (cap.read(frame)) {
         if (frame.empty()) {
             break;
@@ -57,25 +94,18 @@ int main(int argc, char** argv) {
         net.forward(outs, net.getUnconnectedOutLayersNames());
 
         // Process outputs
-        for (auto& output : outs) {
-            float* data = (float*)output.data;
-            for (int i = 0; i < output.rows; ++i, data += output.cols) {
-                cv::Mat scores = output.row(i).colRange(5, output.cols);
-                cv::Point classIdPoint;
-                double confidence;
-                cv::minMaxLoc(scores, nullptr, &confidence, nullptr, &classIdPoint);
-                if (confidence > 0.4 && (classIdPoint.x == 1 || classIdPoint.x == 0)) {  // Check if detected class is "bicycle"
-                    int centerX = (int)(data[0] * frame.cols);
-                    int centerY = (int)(data[1] * frame.rows);
-                    int width = (int)(data[2] * frame.cols);
-                    int height = (int)(data[3] * frame.rows);
-                    int left = centerX - width / 2;
-                    int top = centerY - height / 2;
-
-                    cv::rectangle(frame, cv::Point(left, top), cv::Point(left + width, top + height), cv::Scalar(0, 255, 0), 3);
-                    std::cout << "Detected person with confidence: " << confidence * 100 << "%" << std::endl;
-                }
-            }
+        std::vector<cv::Rect> boxes;
+        std::vector<int> classIds;
+        std::vector<float> confidences;
+        // Person (0) and bicycle (1)
+        decodeYolo(outs, cv::Rect(0, 0, frame.cols, frame.rows), 0.4f, 2, boxes, classIds, confidences);
+
+        classAwareNMS(boxes, confidences, classIds, NmsParams(0.4f, 0.3f), indices);
+        events.emitFrame(frameId++, boxes, classIds, confidences, indices);
+
+        for (size_t i = 0; i < indices.size(); ++i) {
+            const cv::Rect &box = boxes[indices[i]];
+            cv::rectangle(frame, box.tl(), box.br(), cv::Scalar(0, 255, 0), 3);
         }
 
         // Display the frame
@@ -83,5 +113,7 @@ int main(int argc, char** argv) {
         if (cv::waitKey(1) == 27) break;  // Stop if ESC key is pressed
     }
 
+    events.close();
+    std::cerr << "Detection events written: " << events.written() << ", dropped: " << events.dropped() << std::endl;
     return 0;
 }